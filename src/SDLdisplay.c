@@ -64,6 +64,89 @@ void sil_getWindowSize(int *w, int *h) {
 }
 
 
+/*****************************************************************************
+  
+  Pixelformat of texture for framebuffer. 16 bits types with alpha are known 
+  by SDL, so these can be uploaded without conversion. All others (and all 
+  framebuffers without a buffer of their own or with colorkey) are converted 
+  to ARGB8888 first.
+
+ *****************************************************************************/
+
+static Uint32 textureFormat(SILFB *fb) {
+  if ((fb->buf)&&(!fb->colorkey)) {
+    if (SILTYPE_4444ARGB==fb->type) return SDL_PIXELFORMAT_ARGB4444;
+    if (SILTYPE_1555ARGB==fb->type) return SDL_PIXELFORMAT_ARGB1555;
+  }
+  return SDL_PIXELFORMAT_ARGB8888;
+}
+
+/*****************************************************************************
+  
+  Upload part of a framebuffer that has the same pixelformat as its texture.
+  Scrolled framebuffers are used as ringbuffer (see sil_scrollLayer), so the
+  area (in layer coordinates) is split in up to four parts, each uploaded 
+  directly from its own place within the buffer.
+
+ *****************************************************************************/
+
+static void uploadRing(SDL_Texture *texture, SILFB *fb, int minx, int miny, int width, int height) {
+  SDL_Rect R;
+  int splitx=fb->width-fb->originx;
+  int splity=fb->height-fb->originy;
+  int bpp=sil_bytesFB(fb->type);
+  int x0,y0,x1,y1,bx,by;
+
+  for (int py=0;py<2;py++) {
+    y0=py?splity:0;
+    y1=py?(int)fb->height:splity;
+    if (y0<miny) y0=miny;
+    if (y1>miny+height) y1=miny+height;
+    if (y0>=y1) continue;
+    for (int px=0;px<2;px++) {
+      x0=px?splitx:0;
+      x1=px?(int)fb->width:splitx;
+      if (x0<minx) x0=minx;
+      if (x1>minx+width) x1=minx+width;
+      if (x0>=x1) continue;
+      R.x=x0;
+      R.y=y0;
+      R.w=x1-x0;
+      R.h=y1-y0;
+      bx=px?x0-splitx:x0+(int)fb->originx;
+      by=py?y0-splity:y0+(int)fb->originy;
+      SDL_UpdateTexture(texture,&R,fb->buf+((uint64_t)by*fb->width+bx)*bpp,fb->width*bpp);
+    }
+  }
+}
+
+/*****************************************************************************
+  
+  Convert part of layer to ARGB in scratch framebuffer (at 0,0), growing
+  scratch framebuffer if needed. Returns 0 if that wasn't possible
+
+ *****************************************************************************/
+
+static UINT toScratch(SILLYR *layer, UINT minx, UINT miny, UINT width, UINT height) {
+  BYTE red,green,blue,alpha;
+
+  if ((width>gv.scratch->width)||(height>gv.scratch->height)) {
+    sil_destroyFB(gv.scratch);
+    gv.scratch=sil_initFB(SIL_MAX(width,(UINT)gv.width),SIL_MAX(height,(UINT)gv.height),SILTYPE_ARGB);
+    if (NULL==gv.scratch) {
+      log_info("ERR: Can't create resized scratch framebuffer for display");
+      return 0;
+    }
+  }
+  for (UINT y=0;y<height;y++) {
+    for (UINT x=0;x<width;x++) {
+      sil_getPixelLayer(layer,minx+x,miny+y,&red,&green,&blue,&alpha);
+      sil_putPixelFB(gv.scratch,x,y,red,green,blue,alpha);
+    }
+  }
+  return 1;
+}
+
 /*****************************************************************************
   
   All other non-SDL display functions uses LayersToFB function to put all 
@@ -71,26 +154,55 @@ void sil_getWindowSize(int *w, int *h) {
   already have all layers as textures inside GPU, so in this case we have to
   update / add missing textures if needed and just place them on top of each
   other...
-  Note that it will be slower when we are not using SILTYPE_ARGB as type
+  Note that it will be slower when we are not using SILTYPE_ARGB (or one of
+  the 16 bits alpha types) as type
 
  *****************************************************************************/
 
 static void LayersToDisplay() {
   SDL_Rect SR,DR;
+  Uint32 fmt,tf;
+  int fw,fh,ox,oy,tw,th;
+  float lalpha;
   UINT scratchw,scratchh;
+  UINT x0,y0,x1,y1;
   BYTE red,green,blue,alpha;
+  BYTE fresh;
+  SILFB *fb;
 
   SILLYR *layer=sil_getBottom();
   SDL_RenderClear(gv.renderer);
   /* loop from bottom to top layer */
   while (layer) {
+    /* nine-slice doesn't know by itself if its source has been drawn on */
+    sil_syncSliceFB(layer->fb);
+    /* tiled layers can be far too large for a texture, so texture only */
+    /* contains the part within the view                                */
+    if (layer->fb->tiles) {
+      tw=layer->view.width;
+      th=layer->view.height;
+    } else {
+      tw=layer->fb->width;
+      th=layer->fb->height;
+    }
+    fmt=textureFormat(layer->fb);
+    if (layer->texture) {
+      /* view of tiled layer or colorkey might have been changed */
+      SDL_QueryTexture(layer->texture,&tf,NULL,&fw,&fh);
+      if ((fw!=tw)||(fh!=th)||(tf!=fmt)) {
+        layer->fb->resized=1;
+        layer->fb->changed=1;
+      }
+    }
     if (layer->fb->resized) {
       if (layer->texture) SDL_DestroyTexture(layer->texture);
       layer->texture=NULL;
     }
+    fresh=0;
     if (NULL==layer->texture) {
       /* no texture yet for this layer */
-      layer->texture=SDL_CreateTexture(gv.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,layer->fb->width,layer->fb->height);
+      fresh=1;
+      layer->texture=SDL_CreateTexture(gv.renderer, fmt, SDL_TEXTUREACCESS_STREAMING,tw,th);
       if (NULL==layer->texture) {
         printf("Warning: can't create texture for layer: %s\n", SDL_GetError());
         layer=layer->next;
@@ -100,14 +212,39 @@ static void LayersToDisplay() {
     }
     /* normally, we would alter every alpha value when copying pixels to destination framebuffer    */
     /* however, we don't do framebuffer handling directly, so we have to override it some other way */
-    if (layer->internal&SILFLAG_ALPHACHANGED) {
-      SDL_SetTextureAlphaMod(layer->texture,(BYTE) (layer->alpha*255));
-      layer->internal^=SILFLAG_ALPHACHANGED;
-    }
-    if (!(layer->flags&SILFLAG_INVISIBLE)) {
-      if (layer->fb->changed) {
-        if (layer->fb->type==SILTYPE_ARGB) {
-          SDL_UpdateTexture(layer->texture,NULL,layer->fb->buf,(layer->fb->width)*4);
+    /* position, alpha and visibility depend on groups the layer is in, too */
+    if (sil_resolveLayer(layer,&ox,&oy,&lalpha)) {
+      if ((layer->internal&SILFLAG_ALPHACHANGED)||(layer->group)) {
+        SDL_SetTextureAlphaMod(layer->texture,(BYTE) (lalpha*255));
+        layer->internal&=~SILFLAG_ALPHACHANGED;
+      }
+      if (layer->fb->tiles) {
+        /* only copy visible part of tiles again if pixels or view changed */
+        fb=layer->fb;
+        if ((fresh)||(fb->changed)||(fb->shown.minx!=layer->view.minx)||(fb->shown.miny!=layer->view.miny)||
+            (fb->shown.width!=layer->view.width)||(fb->shown.height!=layer->view.height)) {
+          if (!toScratch(layer,layer->view.minx,layer->view.miny,tw,th)) return;
+          SDL_UpdateTexture(layer->texture,NULL,gv.scratch->buf,gv.scratch->width*4);
+          fb->shown=layer->view;
+        } else if (fb->damage.width) {
+          /* only the part of damaged area that is visible */
+          x0=SIL_MAX(fb->damage.minx,layer->view.minx);
+          y0=SIL_MAX(fb->damage.miny,layer->view.miny);
+          x1=SIL_MIN(fb->damage.minx+fb->damage.width,layer->view.minx+layer->view.width);
+          y1=SIL_MIN(fb->damage.miny+fb->damage.height,layer->view.miny+layer->view.height);
+          if ((x0<x1)&&(y0<y1)) {
+            if (!toScratch(layer,x0,y0,x1-x0,y1-y0)) return;
+            DR.x=x0-layer->view.minx;
+            DR.y=y0-layer->view.miny;
+            DR.w=x1-x0;
+            DR.h=y1-y0;
+            SDL_UpdateTexture(layer->texture,&DR,gv.scratch->buf,gv.scratch->width*4);
+          }
+        }
+      } else if (layer->fb->changed) {
+        if ((SDL_PIXELFORMAT_ARGB8888!=fmt)||((layer->fb->type==SILTYPE_ARGB)&&(layer->fb->buf)&&(!layer->fb->colorkey))) {
+          /* texture has same format as framebuffer, no need to convert */
+          uploadRing(layer->texture,layer->fb,0,0,layer->fb->width,layer->fb->height);
         } else {
           /* not ARGB , convert it to ARGB                                                 */
           /* use scratch buffer, but to do so, alter its width & height temporarly         */
@@ -140,16 +277,56 @@ static void LayersToDisplay() {
           gv.scratch->width=scratchw;
           gv.scratch->height=scratchh;
         }
+      } else if (layer->fb->damage.width) {
+        /* only part has been changed (like a single cell of a tilemap), update just that */
+        DR.x=layer->fb->damage.minx;
+        DR.y=layer->fb->damage.miny;
+        DR.w=layer->fb->damage.width;
+        DR.h=layer->fb->damage.height;
+        if (SDL_PIXELFORMAT_ARGB8888!=fmt) {
+          /* same format as texture, upload part of buffer directly */
+          uploadRing(layer->texture,layer->fb,DR.x,DR.y,DR.w,DR.h);
+        } else {
+          if (!toScratch(layer,DR.x,DR.y,DR.w,DR.h)) return;
+          SDL_UpdateTexture(layer->texture,&DR,gv.scratch->buf,gv.scratch->width*4);
+        }
       }
-      SR.x=layer->view.minx;
-      SR.y=layer->view.miny;
+      SR.x=layer->fb->tiles?0:layer->view.minx;
+      SR.y=layer->fb->tiles?0:layer->view.miny;
       SR.w=layer->view.width;
       SR.h=layer->view.height;
-      DR.x=layer->relx;
-      DR.y=layer->rely;
+      DR.x=ox;
+      DR.y=oy;
       DR.w=SR.w;
       DR.h=SR.h;
-      SDL_RenderCopy(gv.renderer,layer->texture,&SR,&DR);
+      if ((SILROT_NONE==layer->orient)&&(1==layer->xform.scalex)&&(1==layer->xform.scaley)&&
+          (0==layer->xform.angle)) {
+        SDL_RenderCopy(gv.renderer,layer->texture,&SR,&DR);
+      } else {
+        /* SDL rotates clockwise around center of DR, SIL orientation is         */
+        /* counterclockwise and layer covers relx,rely with width/height swapped */
+        /* scale is applied along display axis, so after orientation             */
+        if (layer->orient&1) {
+          fw=SR.h;
+          fh=SR.w;
+          DR.w=SR.w*layer->xform.scaley;
+          DR.h=SR.h*layer->xform.scalex;
+        } else {
+          fw=SR.w;
+          fh=SR.h;
+          DR.w=SR.w*layer->xform.scalex;
+          DR.h=SR.h*layer->xform.scaley;
+        }
+        DR.x=ox+(fw-DR.w)/2;
+        DR.y=oy+(fh-DR.h)/2;
+#if SDL_VERSION_ATLEAST(2,0,12)
+        SDL_SetTextureScaleMode(layer->texture,(layer->flags&SILFLAG_SMOOTH)?SDL_ScaleModeLinear:SDL_ScaleModeNearest);
+#endif
+        SDL_RenderCopyEx(gv.renderer,layer->texture,&SR,&DR,layer->xform.angle-90.0*layer->orient,NULL,SDL_FLIP_NONE);
+      }
+    } else if ((layer->fb->tiles)&&((layer->fb->changed)||(layer->fb->damage.width))) {
+      /* changes of hidden tiled layer aren't uploaded, copy all when shown again */
+      layer->fb->shown.width=0;
     }
     layer=layer->next;
   }
@@ -159,6 +336,7 @@ static void LayersToDisplay() {
   while(layer) {
     layer->fb->changed=0;
     layer->fb->resized=0;
+    layer->fb->damage.width=0;
     layer=layer->next;
   }
 }
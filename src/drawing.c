@@ -33,12 +33,62 @@ typedef struct _GCOLOR {
 } GCOLOR;
 
 
+/* maximum number of nested clip rectangles */
+#define GCLIPDEPTH 16
+
+/* gradients */
+#define GGRAD_NONE     0
+#define GGRAD_LINEAR   1
+#define GGRAD_RADIAL   2
+#define GGRADSTOPS     8
+#define GGRADSQRT   1024
+/* below this index of square root table, steps in table are too large */
+#define GGRADEXACT    16
+
+typedef struct _GSTOP {
+  float offset;
+  GCOLOR color;
+} GSTOP;
+
+typedef struct _GGRADIENT {
+  BYTE kind;
+  float x1,y1;
+  float x2,y2;
+  float radius;
+  UINT stops;
+  GSTOP stop[GGRADSTOPS];
+} GGRADIENT;
+
+/* size of lookup table for coverage of edge pixels */
+#define GCOVSTEPS 32
+#define GCOVSIZE  (GCOVSTEPS+1)
+
 typedef struct _GDRAW {
   UINT width;
+  BYTE join;
+  BYTE cap;
   GCOLOR fg;
   GCOLOR bg;
+  BYTE coverage[GCOVSIZE];
+  BYTE covinit;
+  SILBOX clip[GCLIPDEPTH];
+  UINT clipcnt;
+  SILDLIST *record;
+  GGRADIENT gradient;
+  BYTE gradlut;
+  GCOLOR gradcolor[256];
+  BYTE gradsqrt[GGRADSQRT+1];
+  BYTE rescale;
 } GDRAW;
 
+/* area to draw in, from minx,miny up to (not including) maxx,maxy */
+typedef struct _GBOX {
+  int minx;
+  int miny;
+  int maxx;
+  int maxy;
+} GBOX;
+
 static GDRAW gd;
 
 /*****************************************************************************
@@ -48,6 +98,9 @@ static GDRAW gd;
  *****************************************************************************/
 void sil_initDraw() {
   gd.width=1;
+  gd.join=SILJOIN_MITER;
+  gd.cap=SILCAP_BUTT;
+  gd.rescale=SILRESCALE_BILINEAR;
   gd.fg.red=255;
   gd.fg.green=255;
   gd.fg.blue=255;
@@ -81,75 +134,6 @@ static int max(int a,int b) {
   return b;
 }
 
-/* primitive function to get square root (without math.h)*/
-/* found on the internet :) */
-
-static float squareroot(int number)
-{
-    int start = 0, end = number;
-    int mid;
-
-    float ans;
-
-    // To find integral part of square
-    // root of number
-    while (start <= end) {
-
-        // Find mid
-        mid = (start + end) / 2;
-
-        // If number is perfect square
-        // then break
-        if (mid * mid == number) {
-            ans = mid;
-            break;
-        }
-
-        // Increment start if integral
-        // part lies on right side
-        // of the mid
-        if (mid * mid < number) {
-            start = mid + 1;
-            ans = mid;
-        }
-
-        // Decrement end if integral part
-        // lies on the left side of the mid
-        else {
-            end = mid - 1;
-        }
-    }
-
-    // To find the fractional part
-    // of square root upto 5 decimal
-    float increment = 0.1;
-    for (int i = 0; i < 5; i++) {
-        while (ans * ans <= number) {
-            ans += increment;
-        }
-
-        // Loop terminates,
-        // when ans * ans > number
-        ans = ans - increment;
-        increment = increment / 10;
-    }
-    return ans;
-}
-
-void floodfill(SILLYR *layer, UINT x,UINT y) {
-  BYTE red,green,blue,alpha;
-
-  if ((x>=layer->fb->width)||(y>=layer->fb->height)) return;
-  sil_getPixelLayer(layer,x,y,&red,&green,&blue,&alpha);
-  if ((red!=gd.fg.red)||(green!=gd.fg.green)||(blue!=gd.fg.blue)||(alpha!=gd.fg.alpha)) {
-    sil_drawPixel(layer,x,y);
-    floodfill(layer,x+1,y);
-    if (x>0) floodfill(layer,x-1,y);
-    floodfill(layer,x,y+1);
-    if (y>0) floodfill(layer,x,y-1);
-  } 
-}
-
 /*****************************************************************************
   swap foreground with background color
 
@@ -220,6 +204,583 @@ UINT sil_getDrawWidth() {
   return gd.width;
 }
 
+void sil_setLineJoin(BYTE join) {
+  gd.join=join;
+}
+
+BYTE sil_getLineJoin() {
+  return gd.join;
+}
+
+void sil_setLineCap(BYTE cap) {
+  gd.cap=cap;
+}
+
+BYTE sil_getLineCap() {
+  return gd.cap;
+}
+
+/*****************************************************************************
+  clip rectangles. Drawing functions will only touch pixels within the 
+  top clip rectangle of the stack (relative to layer that is drawn on). 
+  Every pushed rectangle is intersected with the previous one, so nested
+  widgets can never draw outside area of their parents. 
+
+ *****************************************************************************/
+
+UINT sil_pushClip(UINT x, UINT y, UINT width, UINT height) {
+  UINT maxx,maxy;
+  SILBOX *top;
+
+  if (gd.clipcnt>=GCLIPDEPTH) {
+    log_warn("Too many nested clip rectangles (max %d)",GCLIPDEPTH);
+    return SILERR_NOMEM;
+  }
+  maxx=x+width;
+  maxy=y+height;
+  if (gd.clipcnt) {
+    top=&gd.clip[gd.clipcnt-1];
+    if (x<top->minx) x=top->minx;
+    if (y<top->miny) y=top->miny;
+    if (maxx>top->minx+top->width) maxx=top->minx+top->width;
+    if (maxy>top->miny+top->height) maxy=top->miny+top->height;
+  }
+  gd.clip[gd.clipcnt].minx=x;
+  gd.clip[gd.clipcnt].miny=y;
+  gd.clip[gd.clipcnt].width=(maxx>x)?maxx-x:0;
+  gd.clip[gd.clipcnt].height=(maxy>y)?maxy-y:0;
+  gd.clipcnt++;
+  return SILERR_ALLOK;
+}
+
+void sil_popClip() {
+  if (0==gd.clipcnt) {
+    log_warn("Trying to pop clip rectangle from empty stack");
+    return;
+  }
+  gd.clipcnt--;
+}
+
+/* get area of layer that can be drawn on, returns 0 if there is none */
+static int getClip(SILLYR *layer, GBOX *box) {
+  SILBOX *top;
+
+  box->minx=0;
+  box->miny=0;
+  box->maxx=layer->fb->width;
+  box->maxy=layer->fb->height;
+  if (gd.clipcnt) {
+    top=&gd.clip[gd.clipcnt-1];
+    if ((int)top->minx>box->minx) box->minx=top->minx;
+    if ((int)top->miny>box->miny) box->miny=top->miny;
+    if ((int)(top->minx+top->width)<box->maxx) box->maxx=top->minx+top->width;
+    if ((int)(top->miny+top->height)<box->maxy) box->maxy=top->miny+top->height;
+  }
+  return ((box->minx<box->maxx)&&(box->miny<box->maxy));
+}
+
+/* does area of minx,miny - maxx,maxy (inclusive) overlap with clip rectangle ? */
+static int inClipArea(int minx, int miny, int maxx, int maxy) {
+  SILBOX *top;
+
+  if (0==gd.clipcnt) return 1;
+  top=&gd.clip[gd.clipcnt-1];
+  return ((maxx>=(int)top->minx)&&(minx<(int)(top->minx+top->width))&&
+          (maxy>=(int)top->miny)&&(miny<(int)(top->miny+top->height)));
+}
+
+/* pixel and row functions that respect clip rectangle */
+static void clipBlendPixel(SILLYR *layer, int x, int y, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  if ((x<0)||(y<0)||(!inClipArea(x,y,x,y))) return;
+  sil_blendPixelLayer(layer,x,y,red,green,blue,alpha);
+}
+
+static void clipPutPixel(SILLYR *layer, int x, int y, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  if ((x<0)||(y<0)||(!inClipArea(x,y,x,y))) return;
+  sil_putPixelLayer(layer,x,y,red,green,blue,alpha);
+}
+
+static void clipBlendRow(SILLYR *layer, int x, int y, int len, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  GBOX box;
+
+  if ((len<=0)||(!getClip(layer,&box))) return;
+  if ((y<box.miny)||(y>=box.maxy)) return;
+  if (x<box.minx) {
+    len-=box.minx-x;
+    x=box.minx;
+  }
+  if (x+len>box.maxx) len=box.maxx-x;
+  if (len>0) sil_blendRowLayer(layer,x,y,len,red,green,blue,alpha);
+}
+
+/*****************************************************************************
+  gradients. When set, all fills that normally use the background color 
+  (rectangles, rounded rectangles, circles, ellipses, pies, polygons, paths
+  and flood fill) use the gradient instead. Colors between stops are kept
+  in a table of 256 entries, so every pixel only needs to find its position
+  in the gradient. Along a row that position changes with a constant step
+  (linear) or a constant second step (square of distance for radial).
+  Coordinates are relative to the layer that is drawn on.
+
+ *****************************************************************************/
+
+static void clearStops() {
+  gd.gradient.stops=0;
+  gd.gradlut=0;
+}
+
+void sil_setLinearGradient(float x1, float y1, float x2, float y2) {
+  gd.gradient.kind=GGRAD_LINEAR;
+  gd.gradient.x1=x1;
+  gd.gradient.y1=y1;
+  gd.gradient.x2=x2;
+  gd.gradient.y2=y2;
+  clearStops();
+}
+
+void sil_setRadialGradient(float cx, float cy, float radius) {
+  gd.gradient.kind=GGRAD_RADIAL;
+  gd.gradient.x1=cx;
+  gd.gradient.y1=cy;
+  gd.gradient.radius=radius;
+  clearStops();
+}
+
+void sil_clearGradient() {
+  gd.gradient.kind=GGRAD_NONE;
+  clearStops();
+}
+
+UINT sil_addGradientStop(float offset, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  GSTOP *stop;
+  UINT pos;
+
+  if (GGRAD_NONE==gd.gradient.kind) {
+    log_warn("Adding gradient stop without setting gradient first");
+    return SILERR_NOTINIT;
+  }
+  if (gd.gradient.stops>=GGRADSTOPS) {
+    log_warn("Too many stops for gradient (max %d)",GGRADSTOPS);
+    return SILERR_NOMEM;
+  }
+  if (offset<0) offset=0;
+  if (offset>1) offset=1;
+
+  /* keep stops sorted by offset */
+  pos=gd.gradient.stops;
+  while ((pos>0)&&(gd.gradient.stop[pos-1].offset>offset)) {
+    gd.gradient.stop[pos]=gd.gradient.stop[pos-1];
+    pos--;
+  }
+  stop=&gd.gradient.stop[pos];
+  stop->offset=offset;
+  stop->color.red=red;
+  stop->color.green=green;
+  stop->color.blue=blue;
+  stop->color.alpha=alpha;
+  gd.gradient.stops++;
+  gd.gradlut=0;
+  return SILERR_ALLOK;
+}
+
+/* is there anything to fill with ? */
+static int hasFill() {
+  return ((gd.bg.alpha)||((gd.gradient.kind)&&(gd.gradient.stops)));
+}
+
+static float squarerootf(float);
+
+/* integer square root, rounded down */
+static UINT isqrt(UINT n) {
+  UINT root=0;
+  UINT bit=1u<<30;
+
+  while (bit>n) bit>>=2;
+  while (bit) {
+    if (n>=root+bit) {
+      n-=root+bit;
+      root=(root>>1)+bit;
+    } else {
+      root>>=1;
+    }
+    bit>>=2;
+  }
+  return root;
+}
+
+/* fill table with colors of gradient, and table of square roots for radial */
+static void initGradient() {
+  GSTOP *a,*b;
+  UINT s=0;
+  float t,f;
+
+  for (UINT i=0;i<256;i++) {
+    t=i/255.0;
+    while ((s+1<gd.gradient.stops)&&(gd.gradient.stop[s+1].offset<t)) s++;
+    a=&gd.gradient.stop[s];
+    b=(s+1<gd.gradient.stops)?&gd.gradient.stop[s+1]:a;
+    if ((t<=a->offset)||(b->offset<=a->offset)) {
+      f=(t<=a->offset)?0:1;
+    } else {
+      f=(t-a->offset)/(b->offset-a->offset);
+      if (f>1) f=1;
+    }
+    gd.gradcolor[i].red  =a->color.red  +(b->color.red  -a->color.red)*f;
+    gd.gradcolor[i].green=a->color.green+(b->color.green-a->color.green)*f;
+    gd.gradcolor[i].blue =a->color.blue +(b->color.blue -a->color.blue)*f;
+    gd.gradcolor[i].alpha=a->color.alpha+(b->color.alpha-a->color.alpha)*f;
+  }
+  for (UINT i=0;i<=GGRADSQRT;i++) {
+    gd.gradsqrt[i]=(BYTE)(squarerootf((float)i/GGRADSQRT)*255+0.5);
+  }
+  gd.gradlut=1;
+}
+
+/* write one pixel of gradient, coverage 0-255 */
+static inline void gradientPixel(SILLYR *layer, int x, int y, UINT idx, UINT coverage) {
+  GCOLOR *c=&gd.gradcolor[idx];
+  UINT alpha=(c->alpha*coverage)/255;
+
+  if (255==alpha) {
+    sil_putPixelLayer(layer,x,y,c->red,c->green,c->blue,255);
+  } else if (alpha) {
+    sil_blendPixelLayer(layer,x,y,c->red,c->green,c->blue,alpha);
+  }
+}
+
+/* position in gradient table for square of distance to middle (radial) */
+static UINT radialIndex(float q) {
+  int idx;
+
+  idx=(q>=1)?GGRADSQRT:(int)(q*GGRADSQRT);
+  if (idx<0) idx=0;
+  if (idx<GGRADEXACT) {
+    /* near middle, table would show bands. Use root of 4*q*255*255 */
+    /* there, which is twice the position in gradient, to round it  */
+    idx=(q>0)?(isqrt((UINT)(q*260100+0.5))+1)/2:0;
+    return (idx>255)?255:idx;
+  }
+  return gd.gradsqrt[idx];
+}
+
+/* color of background or gradient at pixel x,y */
+static void fillColor(int x, int y, GCOLOR *c) {
+  float px,py,t,dt,rr;
+  int idx;
+
+  if ((GGRAD_NONE==gd.gradient.kind)||(0==gd.gradient.stops)) {
+    *c=gd.bg;
+    return;
+  }
+  if (!gd.gradlut) initGradient();
+  px=x+0.5-gd.gradient.x1;
+  py=y+0.5-gd.gradient.y1;
+  if (GGRAD_LINEAR==gd.gradient.kind) {
+    dt=(gd.gradient.x2-gd.gradient.x1)*(gd.gradient.x2-gd.gradient.x1)+
+       (gd.gradient.y2-gd.gradient.y1)*(gd.gradient.y2-gd.gradient.y1);
+    if (dt<=0) dt=1;
+    t=(px*(gd.gradient.x2-gd.gradient.x1)+py*(gd.gradient.y2-gd.gradient.y1))*255/dt;
+    idx=(int)(t+0.5);
+    if (idx<0) idx=0;
+    if (idx>255) idx=255;
+  } else {
+    rr=gd.gradient.radius*gd.gradient.radius;
+    if (rr<=0) rr=1;
+    idx=radialIndex((px*px+py*py)/rr);
+  }
+  *c=gd.gradcolor[idx];
+}
+
+/* fill (part of) row with background color or gradient, coverage 0-255 */
+static void paintRow(SILLYR *layer, int x, int y, int len, UINT coverage) {
+  GBOX box;
+  float px,py,t,dt,q,dq,ddq,rr;
+  int idx;
+
+  if ((GGRAD_NONE==gd.gradient.kind)||(0==gd.gradient.stops)) {
+    clipBlendRow(layer,x,y,len,gd.bg.red,gd.bg.green,gd.bg.blue,(coverage*gd.bg.alpha)/255);
+    return;
+  }
+  if ((len<=0)||(0==coverage)||(!getClip(layer,&box))) return;
+  if ((y<box.miny)||(y>=box.maxy)) return;
+  if (x<box.minx) {
+    len-=box.minx-x;
+    x=box.minx;
+  }
+  if (x+len>box.maxx) len=box.maxx-x;
+  if (len<=0) return;
+  if (!gd.gradlut) initGradient();
+
+  px=x+0.5-gd.gradient.x1;
+  py=y+0.5-gd.gradient.y1;
+  if (GGRAD_LINEAR==gd.gradient.kind) {
+    /* position along gradient line, increases by same amount every pixel */
+    dt=(gd.gradient.x2-gd.gradient.x1)*(gd.gradient.x2-gd.gradient.x1)+
+       (gd.gradient.y2-gd.gradient.y1)*(gd.gradient.y2-gd.gradient.y1);
+    if (dt<=0) dt=1;
+    t=(px*(gd.gradient.x2-gd.gradient.x1)+py*(gd.gradient.y2-gd.gradient.y1))*255/dt;
+    dt=(gd.gradient.x2-gd.gradient.x1)*255/dt;
+    for (int i=0;i<len;i++) {
+      idx=(int)(t+0.5);
+      if (idx<0) idx=0;
+      if (idx>255) idx=255;
+      gradientPixel(layer,x+i,y,idx,coverage);
+      t+=dt;
+    }
+  } else {
+    /* square of distance to middle, relative to radius */
+    rr=gd.gradient.radius*gd.gradient.radius;
+    if (rr<=0) rr=1;
+    q=(px*px+py*py)/rr;
+    dq=(2*px+1)/rr;
+    ddq=2/rr;
+    for (int i=0;i<len;i++) {
+      gradientPixel(layer,x+i,y,radialIndex(q),coverage);
+      q+=dq;
+      dq+=ddq;
+    }
+  }
+}
+
+/*****************************************************************************
+  Display lists. While recording, drawing functions don't draw on the 
+  layer, but add a command to the list, holding its parameters, the 
+  drawing settings at that moment (colors, width, joins, caps and clip 
+  rectangle) and a bounding box. sil_drawDisplayList replays them later, 
+  on any layer, skipping commands outside the area that has to be drawn. 
+
+ *****************************************************************************/
+
+#define GDL_NONE          0
+#define GDL_LINE          1
+#define GDL_LINEAA        2
+#define GDL_CIRCLE        3
+#define GDL_CIRCLEAA      4
+#define GDL_ELLIPSEAA     5
+#define GDL_ARCAA         6
+#define GDL_PIEAA         7
+#define GDL_RECTANGLE     8
+#define GDL_ROUNDEDRECT   9
+#define GDL_PATH         10
+#define GDL_POLYLINE     11
+#define GDL_PIXEL        12
+#define GDL_BLENDPIXEL   13
+#define GDL_TEXT         14
+#define GDL_FLOODFILL    15
+
+/* bounding box for commands that can touch whole layer */
+#define GDL_FAR  0x3fffffff
+
+typedef struct _SILDCMD {
+  BYTE kind;
+  GBOX box;
+  GCOLOR fg;
+  GCOLOR bg;
+  GGRADIENT gradient;
+  UINT width;
+  BYTE join;
+  BYTE cap;
+  BYTE hasclip;
+  SILBOX clip;
+  UINT arg[6];
+  SILPOINT *points;
+  UINT *counts;
+  SILFONT *font;
+  char *text;
+} SILDCMD;
+
+static SILDCMD *recordCommand(BYTE kind, int minx, int miny, int maxx, int maxy) {
+  SILDLIST *list=gd.record;
+  SILDCMD *new,*cmd;
+  SILBOX *clip;
+
+  if (list->err) return NULL;
+  if (list->cnt==list->size) {
+    new=realloc(list->cmds,(list->size?list->size*2:32)*sizeof(SILDCMD));
+    if (NULL==new) {
+      log_info("ERR: Can't allocate memory for display list");
+      list->err=1;
+      return NULL;
+    }
+    list->cmds=new;
+    list->size=list->size?list->size*2:32;
+  }
+  cmd=&list->cmds[list->cnt++];
+  memset(cmd,0,sizeof(SILDCMD));
+  cmd->kind=kind;
+  cmd->box.minx=minx;
+  cmd->box.miny=miny;
+  cmd->box.maxx=maxx;
+  cmd->box.maxy=maxy;
+  cmd->fg=gd.fg;
+  cmd->bg=gd.bg;
+  cmd->gradient=gd.gradient;
+  cmd->width=gd.width;
+  cmd->join=gd.join;
+  cmd->cap=gd.cap;
+  if (gd.clipcnt) {
+    /* command can't draw outside clip rectangle that is active now */
+    clip=&gd.clip[gd.clipcnt-1];
+    cmd->hasclip=1;
+    cmd->clip=*clip;
+    if (cmd->box.minx<(int)clip->minx) cmd->box.minx=clip->minx;
+    if (cmd->box.miny<(int)clip->miny) cmd->box.miny=clip->miny;
+    if (cmd->box.maxx>(int)(clip->minx+clip->width)) cmd->box.maxx=clip->minx+clip->width;
+    if (cmd->box.maxy>(int)(clip->miny+clip->height)) cmd->box.maxy=clip->miny+clip->height;
+  }
+  return cmd;
+}
+
+static UINT recordArgs(BYTE kind, int minx, int miny, int maxx, int maxy, UINT a0, UINT a1, UINT a2, UINT a3, UINT a4, UINT a5) {
+  SILDCMD *cmd;
+
+  cmd=recordCommand(kind,minx,miny,maxx,maxy);
+  if (NULL==cmd) return SILERR_NOMEM;
+  cmd->arg[0]=a0;
+  cmd->arg[1]=a1;
+  cmd->arg[2]=a2;
+  cmd->arg[3]=a3;
+  cmd->arg[4]=a4;
+  cmd->arg[5]=a5;
+  return SILERR_ALLOK;
+}
+
+/* record around xm,ym, r pixels and drawing width away */
+static UINT recordRound(BYTE kind, UINT xm, UINT ym, UINT rx, UINT ry, UINT a4, UINT a5) {
+  int m=gd.width+2;
+
+  return recordArgs(kind,(int)xm-(int)rx-m,(int)ym-(int)ry-m,xm+rx+m+1,ym+ry+m+1,xm,ym,rx,ry,a4,a5);
+}
+
+static UINT recordLine(BYTE kind, UINT x1, UINT y1, UINT x2, UINT y2) {
+  int m=gd.width+2;
+
+  return recordArgs(kind,(int)((x1<x2)?x1:x2)-m,(int)((y1<y2)?y1:y2)-m,
+      ((x1>x2)?x1:x2)+m+1,((y1>y2)?y1:y2)+m+1,x1,y1,x2,y2,0,0);
+}
+
+/* record polygon, path or polyline, copying its points */
+static UINT recordPoints(BYTE kind, SILPOINT *points, UINT *counts, UINT contours, float margin, UINT arg) {
+  SILDCMD *cmd;
+  UINT total=0;
+  float minx,miny,maxx,maxy;
+
+  if ((NULL==points)||(NULL==counts)) return SILERR_WRONGFORMAT;
+  for (UINT c=0;c<contours;c++) total+=counts[c];
+  if (0==total) return SILERR_ALLOK;
+  minx=maxx=points[0].x;
+  miny=maxy=points[0].y;
+  for (UINT i=1;i<total;i++) {
+    if (points[i].x<minx) minx=points[i].x;
+    if (points[i].x>maxx) maxx=points[i].x;
+    if (points[i].y<miny) miny=points[i].y;
+    if (points[i].y>maxy) maxy=points[i].y;
+  }
+  cmd=recordCommand(kind,(int)(minx-margin)-1,(int)(miny-margin)-1,(int)(maxx+margin)+2,(int)(maxy+margin)+2);
+  if (NULL==cmd) return SILERR_NOMEM;
+  cmd->points=malloc(total*sizeof(SILPOINT));
+  cmd->counts=malloc(contours*sizeof(UINT));
+  if ((NULL==cmd->points)||(NULL==cmd->counts)) {
+    log_info("ERR: Can't allocate memory for display list");
+    gd.record->err=1;
+    cmd->kind=GDL_NONE;
+    return SILERR_NOMEM;
+  }
+  memcpy(cmd->points,points,total*sizeof(SILPOINT));
+  memcpy(cmd->counts,counts,contours*sizeof(UINT));
+  cmd->arg[0]=contours;
+  cmd->arg[1]=arg;
+  return SILERR_ALLOK;
+}
+
+/* record text, bounding box is based on width and height of all lines */
+static UINT recordText(SILFONT *font, char *text, UINT relx, UINT rely, BYTE flags) {
+  SILDCMD *cmd;
+  UINT lines=1;
+
+  if ((NULL==font)||(NULL==text)) return SILERR_NOTINIT;
+  for (char *c=text;*c;c++) if (('\n'==*c)||('\r'==*c)) lines++;
+  cmd=recordCommand(GDL_TEXT,relx,rely,relx+sil_getTextWidth(font,text,flags)+1,rely+lines*sil_getHeightFont(font)+1);
+  if (NULL==cmd) return SILERR_NOMEM;
+  cmd->text=malloc(strlen(text)+1);
+  if (NULL==cmd->text) {
+    log_info("ERR: Can't allocate memory for display list");
+    gd.record->err=1;
+    cmd->kind=GDL_NONE;
+    return SILERR_NOMEM;
+  }
+  strcpy(cmd->text,text);
+  cmd->font=font;
+  cmd->arg[0]=relx;
+  cmd->arg[1]=rely;
+  cmd->arg[2]=flags;
+  return SILERR_ALLOK;
+}
+
+/* free memory of all commands in list */
+static void freeCommands(SILDLIST *list) {
+  for (UINT i=0;i<list->cnt;i++) {
+    if (list->cmds[i].points) free(list->cmds[i].points);
+    if (list->cmds[i].counts) free(list->cmds[i].counts);
+    if (list->cmds[i].text) free(list->cmds[i].text);
+  }
+  list->cnt=0;
+  list->err=0;
+}
+
+/*****************************************************************************
+  create & destroy display lists, start and stop recording
+
+ *****************************************************************************/
+
+SILDLIST *sil_createDisplayList() {
+  SILDLIST *list;
+
+  list=calloc(1,sizeof(SILDLIST));
+  if (NULL==list) {
+    log_info("ERR: Can't allocate memory for display list");
+    return NULL;
+  }
+  return list;
+}
+
+void sil_clearDisplayList(SILDLIST *list) {
+  if (NULL==list) return;
+  freeCommands(list);
+}
+
+void sil_destroyDisplayList(SILDLIST *list) {
+  if (NULL==list) return;
+  if (gd.record==list) gd.record=NULL;
+  freeCommands(list);
+  if (list->cmds) free(list->cmds);
+  free(list);
+}
+
+UINT sil_startDisplayList(SILDLIST *list) {
+
+#ifndef SIL_LIVEDANGEROUS
+  if (NULL==list) {
+    log_warn("Trying to record into non-existing display list");
+    return SILERR_NOTINIT;
+  }
+  if (gd.record) {
+    log_warn("Already recording a display list");
+    return SILERR_WRONGFORMAT;
+  }
+#endif
+  gd.record=list;
+  return SILERR_ALLOK;
+}
+
+UINT sil_stopDisplayList() {
+  SILDLIST *list=gd.record;
+
+  gd.record=NULL;
+  if ((list)&&(list->err)) return SILERR_NOMEM;
+  return SILERR_ALLOK;
+}
+
 /*****************************************************************************
   load a PNG on location relx, rely into existing layer.
   Will check"SILFLAG_NOBLEND" to see if it just has to overwrite (including
@@ -307,9 +868,9 @@ UINT sil_PNGintoLayer(SILLYR *layer,char * filename,UINT relx,UINT rely) {
       alpha=image[pos];
       if ((x+relx<(layer->fb->width))&&(y+rely<(layer->fb->height))) {
         if (layer->flags&SILFLAG_NOBLEND) {
-          sil_putPixelLayer(layer,x+relx,y+rely,red,green,blue,alpha);
+          clipPutPixel(layer,x+relx,y+rely,red,green,blue,alpha);
         } else {
-          sil_blendPixelLayer(layer,x+relx,y+rely,red,green,blue,alpha);
+          clipBlendPixel(layer,x+relx,y+rely,red,green,blue,alpha);
         }
       }
     }
@@ -346,6 +907,11 @@ void sil_drawText(SILLYR *layer, SILFONT *font, char *text, UINT relx, UINT rely
   int kerning=0;
   UINT outline=0;
 
+  if (gd.record) {
+    recordText(font,text,relx,rely,flags);
+    return;
+  }
+
 #ifndef SIL_LIVEDANGEROUS
   if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
     log_warn("drawing text on a layer that isn't initialized or has unitialized framebuffer");
@@ -390,24 +956,28 @@ void sil_drawText(SILLYR *layer, SILFONT *font, char *text, UINT relx, UINT rely
       continue;
     }
 #endif
-    for (int x=0;x<chardef->width;x++) {
-      for (int y=0;y<chardef->height;y++) {
-        sil_getPixelFont(font,x+chardef->x,y+chardef->y,&red,&green,&blue,&alpha);
-        alpha=alpha*(font->alpha);
-        if (alpha>0) {
-          if (!(flags&SILTXT_KEEPCOLOR)) {
-            if (!(((red==blue)&&(blue==red)&&(red<128))&&(flags&SILTXT_KEEPBLACK))) {
-              alpha=((float)alpha/255)*gd.fg.alpha;
+    /* skip characters completely outside clip rectangle */
+    if (inClipArea(cursor+relx,rely+chardef->yoffset,cursor+relx+chardef->width-1,
+          rely+chardef->yoffset+chardef->height-1)) {
+      for (int x=0;x<chardef->width;x++) {
+        for (int y=0;y<chardef->height;y++) {
+          sil_getPixelFont(font,x+chardef->x,y+chardef->y,&red,&green,&blue,&alpha);
+          alpha=alpha*(font->alpha);
+          if (alpha>0) {
+            if (!(flags&SILTXT_KEEPCOLOR)) {
+              if (!(((red==blue)&&(blue==red)&&(red<128))&&(flags&SILTXT_KEEPBLACK))) {
+                alpha=((float)alpha/255)*gd.fg.alpha;
+              }
+              red=((float)red/255)*gd.fg.red;
+              green=((float)green/255)*gd.fg.green;
+              blue=((float)blue/255)*gd.fg.blue;
+            }
+            if (flags&SILTXT_PUNCHOUT) {
+              if (alpha>50) alpha=0;
+              clipPutPixel(layer,cursor+x+relx,y+rely+chardef->yoffset,red,green,blue,alpha);
+            } else {
+              clipBlendPixel(layer,cursor+x+relx,y+rely+chardef->yoffset,red,green,blue,alpha);
             }
-            red=((float)red/255)*gd.fg.red;
-            green=((float)green/255)*gd.fg.green;
-            blue=((float)blue/255)*gd.fg.blue;
-          }
-          if (flags&SILTXT_PUNCHOUT) {
-            if (alpha>50) alpha=0;
-            sil_putPixelLayer(layer,cursor+x+relx,y+rely+chardef->yoffset,red,green,blue,alpha);
-          } else {
-            sil_blendPixelLayer(layer,cursor+x+relx,y+rely+chardef->yoffset,red,green,blue,alpha);
           }
         }
       }
@@ -495,11 +1065,6 @@ UINT sil_getTextWidth(SILFONT *font, char *text, BYTE flags) {
 
 UINT sil_saveDisplay(char *filename,UINT width, UINT height, UINT wx, UINT wy) {
   SILFB *fb;
-  SILLYR *layer;
-  BYTE red,green,blue,alpha;
-  BYTE mixred,mixgreen,mixblue,mixalpha;
-  float af;
-  float negaf;
   UINT err=0;
 
   
@@ -511,42 +1076,7 @@ UINT sil_saveDisplay(char *filename,UINT width, UINT height, UINT wx, UINT wy) {
   }
 
   /* merge all layers to single fb - within window of given paramaters  */
-  layer=sil_getBottom();
-  while (layer) {
-    if (!(layer->flags&SILFLAG_INVISIBLE)) {
-      for (int y=layer->view.miny; y<(layer->view.miny+layer->view.height); y++) {
-        for (int x=layer->view.minx; x<(layer->view.minx+layer->view.width); x++) {
-          int absx=x+layer->relx-layer->view.minx;
-          int absy=y+layer->rely-layer->view.miny;
-          int rx=x;
-          int ry=y;
-
-          /* draw if it is not within window */
-          if ((absx<wx)||(absy<wy)||(absx>wx+width)||(absy>wy+height)) continue;
-
-          /* adjust wx,wy to 0,0 of framebuffer */
-          absx-=wx;
-          absy-=wy;
-
-          sil_getPixelLayer(layer,rx,ry,&red,&green,&blue,&alpha);
-          if (0==alpha) continue; /* nothing to do if completely transparant */
-          alpha=alpha*layer->alpha;
-          if (255==alpha) {
-            sil_putPixelFB(fb,absx,absy,red,green,blue,255);
-          } else {
-            sil_getPixelFB(fb,absx,absy,&mixred,&mixgreen,&mixblue,&mixalpha);
-            af=((float)alpha)/255;
-            negaf=1-af;
-            red=red*af+negaf*mixred;
-            green=green*af+negaf*mixgreen;
-            blue=blue*af+negaf*mixblue;
-            sil_putPixelFB(fb,absx,absy,red,green,blue,255);
-          }
-        }
-      }
-    }
-    layer=layer->next;
-  }
+  sil_LayersToFBWindow(fb,wx,wy);
 
   /* write to file */
   err=lodepng_encode24_file(filename, fb->buf, width, height);
@@ -663,7 +1193,7 @@ void drawSingleLine(SILLYR *layer,UINT x1, UINT y1, UINT x2, UINT y2, BYTE overl
   if (x1 == x2) {
     if (y2<y1) swapcoords(&x1,&y1,&x2,&y2);
     while(y1<=y2) {
-      sil_blendPixelLayer(layer, x1,y1++, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      clipBlendPixel(layer, x1,y1++, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     }
     return;
   }
@@ -671,7 +1201,7 @@ void drawSingleLine(SILLYR *layer,UINT x1, UINT y1, UINT x2, UINT y2, BYTE overl
   if (y1 == y2) {
     if (x2<x1) swapcoords(&x1,&y1,&x2,&y2);
     while(x1<=x2) {
-      sil_blendPixelLayer(layer, x1++,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      clipBlendPixel(layer, x1++,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     } 
     return;
   }
@@ -687,7 +1217,7 @@ void drawSingleLine(SILLYR *layer,UINT x1, UINT y1, UINT x2, UINT y2, BYTE overl
   tDeltaXTimes2 = tDeltaX*2;
   tDeltaYTimes2 = tDeltaY*2;
 
-  sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+  clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
 
   if (tDeltaX > tDeltaY) {
     /* stepping over X axis */
@@ -695,13 +1225,13 @@ void drawSingleLine(SILLYR *layer,UINT x1, UINT y1, UINT x2, UINT y2, BYTE overl
     while (x1 != x2) {
       x1 += tStepX;
       if (tError >= 0) {
-        if (overlap & SILLO_MAJOR) sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+        if (overlap & SILLO_MAJOR) clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         y1 += tStepY;
-        if (overlap & SILLO_MINOR) sil_blendPixelLayer(layer, x1-tStepX,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+        if (overlap & SILLO_MINOR) clipBlendPixel(layer, x1-tStepX,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         tError -= tDeltaXTimes2;
       }
       tError += tDeltaYTimes2;
-      sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     }
   } else {
     /* stepping over y axis */
@@ -709,16 +1239,16 @@ void drawSingleLine(SILLYR *layer,UINT x1, UINT y1, UINT x2, UINT y2, BYTE overl
     while (y1 != y2) {
       y1 += tStepY;
       if (tError >= 0) {
-        if (overlap & SILLO_MAJOR) sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+        if (overlap & SILLO_MAJOR) clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         x1 += tStepX;
-        if (overlap & SILLO_MINOR) sil_blendPixelLayer(layer, x1,y1-tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+        if (overlap & SILLO_MINOR) clipBlendPixel(layer, x1,y1-tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         tError -= tDeltaYTimes2;
       }
       tError += tDeltaXTimes2;
       sil_drawPixel(layer,x1,y1);
     }
   }
-  sil_blendPixelLayer(layer, x2,y2, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+  clipBlendPixel(layer, x2,y2, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
 }
 
 
@@ -740,6 +1270,11 @@ void sil_drawLine(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2) {
   BYTE tOverlap=0;
 
 
+  if (gd.record) {
+    recordLine(GDL_LINE,x1,y1,x2,y2);
+    return;
+  }
+
 #ifndef SIL_LIVEDANGEROUS
   if (NULL==layer) {
     log_warn("Trying to draw non-existing layer");
@@ -760,6 +1295,10 @@ void sil_drawLine(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2) {
   }
 #endif
 
+  /* nothing to do if line is completely outside clip rectangle */
+  if (!inClipArea(((x1<x2)?x1:x2)-gd.width,((y1<y2)?y1:y2)-gd.width,
+        ((x1>x2)?x1:x2)+gd.width,((y1>y2)?y1:y2)+gd.width)) return;
+
   /* if it has one single line, use that function */
   if (gd.width<2) {
     drawSingleLine(layer,x1,y1,x2,y2,SILLO_NONE);
@@ -888,7 +1427,7 @@ static void drawSingleLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2,
   if (x1 == x2+1) {
     if (y2<y1) swapcoords(&x1,&y1,&x2,&y2);
     while(y1<=y2) {
-      sil_blendPixelLayer(layer, x1,y1++, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      clipBlendPixel(layer, x1,y1++, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     }
     return;
   }
@@ -896,7 +1435,7 @@ static void drawSingleLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2,
   if (y1 == y2) {
     if (x2<x1) swapcoords(&x1,&y1,&x2,&y2);
     while(x1<=x2) {
-      sil_blendPixelLayer(layer, x1++,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      clipBlendPixel(layer, x1++,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     } 
     return;
   }
@@ -923,16 +1462,16 @@ static void drawSingleLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2,
       cor=(fraction<0)?-1:1;
       fraction*=cor;
       if ((SILLO_MAJOR|SILLO_MINOR)==overlap) {
-        sil_blendPixelLayer(layer, x1,y1-cor*tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
-        sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
+        clipBlendPixel(layer, x1,y1-cor*tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
+        clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
       } else {
         if (SILLO_NONE==overlap) {
-          sil_blendPixelLayer(layer, x1,y1-cor*tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+          clipBlendPixel(layer, x1,y1-cor*tStepY, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         } else {
           if (SILLO_MAJOR==overlap) {
-            sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (fraction)*gd.fg.alpha);
+            clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (fraction)*gd.fg.alpha);
           } else {
-            sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
+            clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
           }
         }
       }
@@ -957,16 +1496,16 @@ static void drawSingleLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2,
       cor=(fraction<0)?-1:1;
       fraction*=cor;
       if ((SILLO_MAJOR|SILLO_MINOR)==overlap) {
-        sil_blendPixelLayer(layer, x1-cor*tStepX, y1, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
-        sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
+        clipBlendPixel(layer, x1-cor*tStepX, y1, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
+        clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
       } else {
         if (SILLO_NONE==overlap) {
-          sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+          clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
         } else {
           if (SILLO_MAJOR==overlap) {
-            sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
+            clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, fraction*gd.fg.alpha);
           } else {
-            sil_blendPixelLayer(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
+            clipBlendPixel(layer, x1,y1, gd.fg.red, gd.fg.green, gd.fg.blue, (1-fraction)*gd.fg.alpha);
           }
         }
       }
@@ -983,22 +1522,27 @@ static void drawSingleLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2,
   }
 }
 
+static UINT strokePolyline(SILLYR *, SILPOINT *, UINT, BYTE, GCOLOR *);
+
 /*****************************************************************************
 
    Draw Line anti-aliased from x1,y1 to x2,y2 with current color and thickness
+   Thick lines are stroked using current line cap. With the default one 
+   (SILCAP_BUTT) the line is made half a pixel longer at both ends, so the 
+   pixels at x1,y1 and x2,y2 are still fully covered, just like lines drawn 
+   by earlier versions (ends are now square to the line, not to the axis). 
 
  *****************************************************************************/
 
 
 void sil_drawLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2) {
-  int i,tDeltaX,tDeltaY,tDeltaXTimes2, tDeltaYTimes2, tError, tStepX, tStepY;
-  int tDrawStartAdjustCount;
-  UINT bx1,by1,bx2,by2;
-  UINT ex1,ey1,ex2,ey2;
-  BYTE tSwap=1;
-  BYTE tOverlap=0;
-  char dir;
+  SILPOINT line[2];
+  float dx,dy,len;
 
+  if (gd.record) {
+    recordLine(GDL_LINEAA,x1,y1,x2,y2);
+    return;
+  }
 
 #ifndef SIL_LIVEDANGEROUS
   if (NULL==layer) {
@@ -1020,141 +1564,46 @@ void sil_drawLineAA(SILLYR *layer, UINT x1, UINT y1, UINT x2, UINT y2) {
   }
 #endif
 
+  /* nothing to do if line is completely outside clip rectangle */
+  if (!inClipArea(((x1<x2)?x1:x2)-gd.width,((y1<y2)?y1:y2)-gd.width,
+        ((x1>x2)?x1:x2)+gd.width,((y1>y2)?y1:y2)+gd.width)) return;
+
   /* if it has one single line, use that function */
   if (gd.width<2) {
     drawSingleLineAA(layer,x1,y1,x2,y2,SILLO_MAJOR|SILLO_MINOR);
     return;
   }
-  tDeltaY=absint(x2-x1);
-  tDeltaX=absint(y2-y1);
-  tSwap=1;
-  if (x1>x2) {
-    tStepX=-1;
-    tSwap=0;
-  } else {
-    tStepX=1;
-  }
-  if (y1>y2) {
-    tStepY=-1;
-    tSwap=(0==tSwap)?1:0;
-  } else {
-    tStepY=1;
-  }
-  tDeltaXTimes2=tDeltaX*2;
-  tDeltaYTimes2=tDeltaY*2;
-  tDrawStartAdjustCount=gd.width/2;
-  dir=tStepX*tStepY;
-
-  if (tDeltaX >= tDeltaY) {
-    /* step over X */
 
-    if (tSwap) {
-      tDrawStartAdjustCount = (gd.width-1)-tDrawStartAdjustCount;
-      tStepY=-tStepY;
+  /* otherwise, stroke it through middle of the pixels as one polygon */
+  line[0].x=x1+0.5;
+  line[0].y=y1+0.5;
+  line[1].x=x2+0.5;
+  line[1].y=y2+0.5;
+  if (SILCAP_BUTT==gd.cap) {
+    dx=line[1].x-line[0].x;
+    dy=line[1].y-line[0].y;
+    len=squarerootf(dx*dx+dy*dy);
+    if (len>0) {
+      dx*=0.5/len;
+      dy*=0.5/len;
     } else {
-      tStepX=-tStepX;
+      /* single pixel, becomes a short vertical line of width pixels */
+      dx=0.5;
     }
+    line[0].x-=dx;
+    line[0].y-=dy;
+    line[1].x+=dx;
+    line[1].y+=dy;
+  }
+  strokePolyline(layer,line,2,0,&gd.fg);
+}
 
-    tError=tDeltaYTimes2 - tDeltaX;
-    for (i = tDrawStartAdjustCount; i > 0; i--) {
-      x1 -= tStepX;
-      x2 -= tStepX;
-      if (tError >= 0) {
-        y1 -= tStepY;
-        y2 -= tStepY;
-        tError -= tDeltaXTimes2;
-      }
-      tError += tDeltaYTimes2;
-    }
 
-    /* remember starting line */
-    bx1=x1;by1=y1;
-    bx2=x2;by2=y2;
 
-    /* draw gd.width number of lines */
-    tError = tDeltaYTimes2 - tDeltaX;
-    for (i = gd.width; i > 1; i--) {
-      ey1=y1;
-      ey2=y2;
-      x1 += tStepX;
-      x2 += tStepX;
-      tOverlap = SILLO_NONE;
-      if (tError >= 0) {
-        y1 += tStepY;
-        y2 += tStepY;
-        tError -= tDeltaXTimes2;
-        tOverlap = SILLO_MAJOR|SILLO_MINOR;
-      }
-      ex1=x1;
-      ex2=x2;
-      tError += tDeltaYTimes2;
-      if (i>2) drawSingleLine(layer,x1, y1, x2, y2,tOverlap );
-    }
-  } else {
-  /* step over Y */
+/*****************************************************************************
 
-    if (tSwap) {
-      tStepX = -tStepX;
-    } else {
-      tDrawStartAdjustCount = (gd.width-1) - tDrawStartAdjustCount;
-      tStepY = -tStepY;
-    }
-
-    tError = tDeltaXTimes2 - tDeltaY;
-    for (i = tDrawStartAdjustCount; i > 0; i--) {
-      y1 -= tStepY;
-      y2 -= tStepY;
-      if (tError >= 0) {
-        x1 -= tStepX;
-        x2 -= tStepX;
-        tError -= tDeltaYTimes2;
-      }
-      tError += tDeltaXTimes2;
-    }
-
-    /* remember starting line */
-    bx1=x1;by1=y1;
-    bx2=x2;by2=y2;
-
-    tError = tDeltaXTimes2 - tDeltaY;
-    for (i = gd.width; i > 1; i--) {
-      ex1=x1;
-      ex2=x2;
-      y1 += tStepY;
-      y2 += tStepY;
-      tOverlap = SILLO_NONE;
-      if (tError >= 0) {
-        x1 += tStepX;
-        x2 += tStepX;
-        tError -= tDeltaYTimes2;
-        tOverlap = SILLO_MAJOR|SILLO_MINOR;
-      }
-      tError += tDeltaXTimes2;
-      ey1=y1;
-      ey2=y2;
-      if (i>2) drawSingleLine(layer,x1, y1, x2, y2,tOverlap );
-    }
-  }
-  /* draw border lines Aliased on top of it */
-  if (dir<0) {
-    drawSingleLineAA(layer,bx1, by1, bx2, by2,SILLO_MINOR);
-    drawSingleLineAA(layer,ex1, ey1, ex2, ey2,SILLO_MAJOR);
-    drawSingleLineAA(layer,bx1, by1, ex1, ey1,SILLO_MAJOR|SILLO_MINOR);
-    drawSingleLineAA(layer,bx2, by2, ex2, ey2,SILLO_MAJOR|SILLO_MINOR);
-  } else {
-    drawSingleLineAA(layer,bx1, by1, bx2, by2,SILLO_MAJOR);
-    drawSingleLineAA(layer,ex1, ey1, ex2, ey2,SILLO_MINOR);
-    drawSingleLineAA(layer,bx1, by1, ex1, ey1,SILLO_MAJOR|SILLO_MINOR);
-    drawSingleLineAA(layer,bx2, by2, ex2, ey2,SILLO_MAJOR|SILLO_MINOR);
-  }
-}
-
-
-
-/*****************************************************************************
-
-   Draw Single Circle with xm,ym being middle point and r the radius  
-   fastest way
+   Draw Single Circle with xm,ym being middle point and r the radius  
+   fastest way
 
  *****************************************************************************/
 
@@ -1167,14 +1616,14 @@ static void drawSingleCircle(SILLYR *layer, UINT xm, UINT ym, UINT r) {
   int rerr=0;
 
   while(x>=y) {
-    sil_blendPixelLayer(layer,xm + x, ym + y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm - x, ym + y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm - x, ym - y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm + x, ym - y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm + y, ym + x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm - y, ym + x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm - y, ym - x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-    sil_blendPixelLayer(layer,xm + y, ym - x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm + x, ym + y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm - x, ym + y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm - x, ym - y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm + x, ym - y,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm + y, ym + x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm - y, ym + x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm - y, ym - x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    clipBlendPixel(layer,xm + y, ym - x,gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     y++;
     rerr+=ych;
     ych+=2;
@@ -1186,51 +1635,6 @@ static void drawSingleCircle(SILLYR *layer, UINT xm, UINT ym, UINT r) {
   }
 }
 
-/* internal function to draw pixels on 4 places, preventing overwriting same pixel */
-/* fgflag=1 will use foreground color, fgflag=0 will use background */
-
-#define BG_COLOR 0
-#define FG_COLOR 1
-
-static void drawAround(SILLYR *layer, UINT xm, UINT ym, UINT x1, UINT y1, BYTE fgflag ) {
-  BYTE red,green,blue,alpha;
-
-  if (FG_COLOR==fgflag) {
-    red  =gd.fg.red;
-    green=gd.fg.green;
-    blue =gd.fg.blue;
-    alpha=gd.fg.alpha;
-  } else {
-    red  =gd.bg.red;
-    green=gd.bg.green;
-    blue =gd.bg.blue;
-    alpha=gd.bg.alpha;
-  }
-  if (x1>0) {
-    if (y1>0) {
-      /* x1>0, y1>0 */
-      sil_blendPixelLayer(layer, xm+x1, ym+y1,red,green,blue,alpha);
-      sil_blendPixelLayer(layer, xm-x1, ym+y1,red,green,blue,alpha);
-      sil_blendPixelLayer(layer, xm+x1, ym-y1,red,green,blue,alpha);
-      sil_blendPixelLayer(layer, xm-x1, ym-y1,red,green,blue,alpha);
-    } else {
-      /* x1>0, y1=0 */
-      sil_blendPixelLayer(layer, xm+x1, ym,red,green,blue,alpha);
-      sil_blendPixelLayer(layer, xm-x1, ym,red,green,blue,alpha);
-    }
-  } else {
-    if (y1>0) {
-      /* x1=0, y1>0 */
-      sil_blendPixelLayer(layer, xm, ym+y1,red,green,blue,alpha);
-      sil_blendPixelLayer(layer, xm, ym-y1,red,green,blue,alpha);
-    } else {
-      /* x1=0,y1=0, center */
-      sil_blendPixelLayer(layer, xm, ym,red,green,blue,alpha);
-    }
-  }
-}
-
-
 /*****************************************************************************
 
    Draw Circle with xm,ym being middle point and r the radius and using 
@@ -1238,9 +1642,14 @@ static void drawAround(SILLYR *layer, UINT xm, UINT ym, UINT x1, UINT y1, BYTE f
 
  *****************************************************************************/
 void sil_drawCircle(SILLYR *layer, UINT xm, UINT ym, UINT r) {
-  UINT x1,y1,x2,y2;
-  UINT innersq,outersq,xsq,ysq;
+  UINT innersq,outersq,ysq;
   UINT width;
+  int rout,xo,xi;
+
+  if (gd.record) {
+    recordRound(GDL_CIRCLE,xm,ym,r,r,0,0);
+    return;
+  }
 
 #ifndef SIL_LIVEDANGEROUS
   if (NULL==layer) {
@@ -1268,39 +1677,45 @@ void sil_drawCircle(SILLYR *layer, UINT xm, UINT ym, UINT r) {
   }
 #endif
 
-  if ((0==gd.bg.alpha)&&(1==gd.width)) {
+  /* nothing to do if circle is completely outside clip rectangle */
+  if (!inClipArea(xm-r-gd.width,ym-r-gd.width,xm+r+gd.width,ym+r+gd.width)) return;
+
+  if ((!hasFill())&&(1==gd.width)) {
     /* just use faster algorithm for single point circles */
     drawSingleCircle(layer,xm,ym,r);
     return;
   }
 
 
-  /* otherwise, do it the hard way                                           */
-  /* check if every pixel in quadrant if it is in range to be part of circle */
+  /* otherwise, draw it row by row. Pixels within inner circle are fill,  */
+  /* those between inner and outer circle (inclusive) are border. Per row */
+  /* xi and xo are the largest x within inner and outer circle            */
   width=gd.width;
   innersq=r-width/2;
   outersq=innersq+width;
+  rout=outersq;
   innersq=innersq*innersq;
   outersq=outersq*outersq;
   if (0==width) innersq=outersq+1;
-  for (x1=0;x1<=r+width;x1++) {
-    xsq=x1*x1;
-    for (y1=0;y1<=r+width;y1++) {
-      ysq=y1*y1;
-      if (ysq+xsq<=outersq) {
-        if (ysq+xsq>=innersq) {
-          /* border */
-          drawAround(layer,xm,ym,x1,y1,FG_COLOR);
-        } else {
-          /* inside */
-          drawAround(layer,xm,ym,x1,y1,BG_COLOR);
-        }
+  for (int y=-rout;y<=rout;y++) {
+    ysq=y*y;
+    xo=isqrt(outersq-ysq);
+    xi=(innersq>ysq)?(int)isqrt(innersq-ysq-1):-1;
+    if ((xi>=0)&&(hasFill())) paintRow(layer,xm-xi,ym+y,2*xi+1,255);
+    if ((xo>xi)&&(gd.fg.alpha)) {
+      if (xi<0) {
+        clipBlendRow(layer,xm-xo,ym+y,2*xo+1,gd.fg.red,gd.fg.green,gd.fg.blue,gd.fg.alpha);
+      } else {
+        clipBlendRow(layer,xm-xo,ym+y,xo-xi,gd.fg.red,gd.fg.green,gd.fg.blue,gd.fg.alpha);
+        clipBlendRow(layer,xm+xi+1,ym+y,xo-xi,gd.fg.red,gd.fg.green,gd.fg.blue,gd.fg.alpha);
       }
     }
   }
 }
 
 
+static void drawEllipseAA(SILLYR *, float, float, float, float);
+
 /*****************************************************************************
 
    Draw Circle Anti-Aliased with xm,ym being middle point and r the radius 
@@ -1308,10 +1723,10 @@ void sil_drawCircle(SILLYR *layer, UINT xm, UINT ym, UINT r) {
 
  *****************************************************************************/
 void sil_drawCircleAA(SILLYR *layer, UINT xm, UINT ym, UINT r) {
-  UINT x1,y1,x2,y2;
-  UINT innersq,outersq,xsq,ysq;
-  UINT width;
-  BYTE alpha;
+  if (gd.record) {
+    recordRound(GDL_CIRCLEAA,xm,ym,r,r,0,0);
+    return;
+  }
 
 #ifndef SIL_LIVEDANGEROUS
   if (NULL==layer) {
@@ -1339,72 +1754,7 @@ void sil_drawCircleAA(SILLYR *layer, UINT xm, UINT ym, UINT r) {
   }
 #endif
 
-
-  /* do it the hard way */
-  r--;
-  width=gd.width;
-  if (width>1) {
-    /* substract one pixel, later used for AA */
-    width--;
-  }
-  innersq=r-width/2;
-  outersq=innersq+width;
-  innersq=innersq*innersq;
-  outersq=outersq*outersq;
-  if (0==width) {
-    innersq=outersq+1;
-  }
-  for (x1=0;x1<=r+width;x1++) {
-    xsq=x1*x1;
-    for (y1=0;y1<=r+width;y1++) {
-      ysq=y1*y1;
-      if (ysq+xsq<=outersq) {
-        if (ysq+xsq>=innersq) {
-          if (width>0) {
-            /* border */
-            drawAround(layer,xm,ym,x1,y1,FG_COLOR);
-          }
-        } else {
-          /* inside */
-          drawAround(layer,xm,ym,x1,y1,BG_COLOR);
-          if (ysq+xsq>=innersq-(r*2)) {
-            /* AA of innercircle */
-            if (width>0) {
-              alpha=gd.fg.alpha*(1-(innersq-xsq-ysq)/(2.0*r));
-              sil_blendPixelLayer(layer, xm+x1, ym+y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-              sil_blendPixelLayer(layer, xm+x1, ym-y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-              sil_blendPixelLayer(layer, xm-x1, ym+y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-              sil_blendPixelLayer(layer, xm-x1, ym-y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-            } else {
-              alpha=gd.bg.alpha*(1-(innersq-xsq-ysq)/(2.0*r));
-              sil_blendPixelLayer(layer, xm+x1, ym+y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-              sil_blendPixelLayer(layer, xm-x1, ym+y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-              sil_blendPixelLayer(layer, xm+x1, ym-y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-              sil_blendPixelLayer(layer, xm-x1, ym-y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-            }
-          }
-
-        }
-      } else {
-        /* AA of outercircle */
-        if (ysq+xsq<=outersq+(r*2)) {
-          if (width>0) {
-            alpha=gd.fg.alpha*(1-(xsq+ysq-outersq)/(2.0*r));
-            sil_blendPixelLayer(layer, xm+x1, ym+y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-            sil_blendPixelLayer(layer, xm-x1, ym+y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-            sil_blendPixelLayer(layer, xm+x1, ym-y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-            sil_blendPixelLayer(layer, xm-x1, ym-y1, gd.fg.red, gd.fg.green, gd.fg.blue, alpha);
-          } else {
-            alpha=gd.bg.alpha*(1-(xsq+ysq-outersq)/(2.0*r));
-            sil_blendPixelLayer(layer, xm+x1, ym+y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-            sil_blendPixelLayer(layer, xm-x1, ym+y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-            sil_blendPixelLayer(layer, xm+x1, ym-y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-            sil_blendPixelLayer(layer, xm-x1, ym-y1, gd.bg.red, gd.bg.green, gd.bg.blue, alpha);
-          }
-        }
-      }
-    }
-  }
+  drawEllipseAA(layer,xm+0.5,ym+0.5,r,r);
 }
 
 
@@ -1416,6 +1766,12 @@ void sil_drawCircleAA(SILLYR *layer, UINT xm, UINT ym, UINT r) {
  *****************************************************************************/
 
 void sil_drawRectangle(SILLYR *layer, UINT x, UINT y, UINT width, UINT height) {
+  UINT bw;
+
+  if (gd.record) {
+    recordArgs(GDL_RECTANGLE,x,y,x+width,y+height,x,y,width,height,0,0);
+    return;
+  }
 
 #ifndef SIL_LIVEDANGEROUS
   if (NULL==layer) {
@@ -1432,107 +1788,1691 @@ void sil_drawRectangle(SILLYR *layer, UINT x, UINT y, UINT width, UINT height) {
   }
 #endif
 
+  bw=gd.width;
+  if (!inClipArea(x,y,x+width-1,y+height-1)) return;
   for (UINT yc=0;yc<height;yc++) {
-    for (UINT xc=0;xc<width;xc++) {
-      if (((x+xc)<layer->fb->width)&&((y+yc)<layer->fb->height)) {
-        if ((xc<gd.width)||(xc>=width-gd.width)||(yc<gd.width)||(yc>=height-gd.width)) {
-          /* border */
-          sil_blendPixelLayer(layer, x+xc, y+yc, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
-        } else {
-          sil_blendPixelLayer(layer, x+xc, y+yc, gd.bg.red, gd.bg.green, gd.bg.blue, gd.bg.alpha);
-        }
-      }
+    if ((yc<bw)||(yc+bw>=height)||(2*bw>=width)) {
+      /* border */
+      clipBlendRow(layer, x, y+yc, width, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+    } else {
+      clipBlendRow(layer, x, y+yc, bw, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+      paintRow(layer, x+bw, y+yc, width-2*bw, 255);
+      clipBlendRow(layer, x+width-bw, y+yc, bw, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
     }
   }
 }
 
 
+/*****************************************************************************
 
+   Flood fill, starting at x,y, with background color. Fill stops at pixels
+   with foreground color (the border, like with circles and rectangles), 
+   or any color that doesn't differ more then tolerance (0-255, per 
+   channel) from it. 
 
+   Instead of recursing for every pixel, it fills whole spans of a row at 
+   once and keeps a stack of spans still to check in rows above and below.
+   A bitmap of visited pixels is used, so fill color can be anything, even
+   the same as the border.
 
-/*****************************************************************************
-
-   Draw Pixel at x,y with current color
+   Returns SILERR_ALLOK or SILERR_NOMEM 
 
  *****************************************************************************/
 
-void sil_drawPixel(SILLYR *layer, UINT x, UINT y) {
-  /* checks on validity of layer, fb and all is done in putPixelLayer function already */
-  sil_putPixelLayer(layer, x, y, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+typedef struct _GSPAN {
+  UINT x;
+  UINT y;
+} GSPAN;
+
+typedef struct _GFILL {
+  SILLYR *layer;
+  BYTE *seen;
+  UINT stride;
+  GSPAN *stack;
+  UINT cnt;
+  UINT size;
+  BYTE tolerance;
+  GCOLOR border;
+} GFILL;
+
+static inline int isSeen(GFILL *f, UINT x, UINT y) {
+  return (f->seen[y*f->stride+(x>>3)]&(0x80>>(x&7)))?1:0;
+}
+
+/* can pixel be filled ? */
+static int fillable(GFILL *f, UINT x, UINT y) {
+  BYTE red,green,blue,alpha;
+
+  if (isSeen(f,x,y)) return 0;
+  sil_getPixelLayer(f->layer,x,y,&red,&green,&blue,&alpha);
+  if ((absint(red-f->border.red)<=f->tolerance)&&(absint(green-f->border.green)<=f->tolerance)&&
+      (absint(blue-f->border.blue)<=f->tolerance)&&(absint(alpha-f->border.alpha)<=f->tolerance)) return 0;
+  return 1;
+}
+
+static int pushSpan(GFILL *f, UINT x, UINT y) {
+  GSPAN *new;
+
+  if (f->cnt==f->size) {
+    new=realloc(f->stack,(f->size?f->size*2:64)*sizeof(GSPAN));
+    if (NULL==new) {
+      log_info("ERR: Can't allocate memory for stack of floodfill");
+      return 0;
+    }
+    f->stack=new;
+    f->size=f->size?f->size*2:64;
+  }
+  f->stack[f->cnt].x=x;
+  f->stack[f->cnt].y=y;
+  f->cnt++;
+  return 1;
+}
+
+/* push start of every fillable run within minx..maxx of given row */
+static int pushRow(GFILL *f, UINT minx, UINT maxx, UINT y) {
+  BYTE inrun=0;
+
+  for (UINT x=minx;x<=maxx;x++) {
+    if (fillable(f,x,y)) {
+      if ((!inrun)&&(!pushSpan(f,x,y))) return 0;
+      inrun=1;
+    } else {
+      inrun=0;
+    }
+  }
+  return 1;
+}
+
+UINT sil_floodFill(SILLYR *layer, UINT x, UINT y, BYTE tolerance) {
+  GFILL f;
+  GBOX box;
+  UINT minx,maxx,width,height;
+  UINT err=SILERR_ALLOK;
+
+  if (gd.record) return recordArgs(GDL_FLOODFILL,-GDL_FAR,-GDL_FAR,GDL_FAR,GDL_FAR,x,y,tolerance,0,0,0);
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to floodfill non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+#endif
+  width=layer->fb->width;
+  height=layer->fb->height;
+
+  /* fill stops at edges of clip rectangle as well */
+  if (!getClip(layer,&box)) return SILERR_ALLOK;
+  if (((int)x<box.minx)||((int)x>=box.maxx)||((int)y<box.miny)||((int)y>=box.maxy)) return SILERR_ALLOK;
+
+  memset(&f,0,sizeof(GFILL));
+  f.layer=layer;
+  f.tolerance=tolerance;
+  f.border=gd.fg;
+  sil_quantizeFB(layer->fb->type,&f.border.red,&f.border.green,&f.border.blue);
+  f.stride=(width+7)/8;
+  f.seen=calloc((uint64_t)f.stride*height,1);
+  if (NULL==f.seen) {
+    log_info("ERR: Can't allocate memory for floodfill");
+    return SILERR_NOMEM;
+  }
+
+  if ((fillable(&f,x,y))&&(!pushSpan(&f,x,y))) err=SILERR_NOMEM;
+  while ((f.cnt)&&(SILERR_ALLOK==err)) {
+    f.cnt--;
+    x=f.stack[f.cnt].x;
+    y=f.stack[f.cnt].y;
+    if (!fillable(&f,x,y)) continue;
+
+    /* extend to the left and right as far as possible */
+    minx=x;
+    maxx=x;
+    while (((int)minx>box.minx)&&(fillable(&f,minx-1,y))) minx--;
+    while (((int)maxx+1<box.maxx)&&(fillable(&f,maxx+1,y))) maxx++;
+
+    if ((GGRAD_NONE==gd.gradient.kind)||(0==gd.gradient.stops)) {
+      sil_fillRowLayer(layer,minx,y,maxx-minx+1,gd.bg.red,gd.bg.green,gd.bg.blue,gd.bg.alpha);
+    } else {
+      paintRow(layer,minx,y,maxx-minx+1,255);
+    }
+    for (UINT i=minx;i<=maxx;i++) f.seen[y*f.stride+(i>>3)]|=0x80>>(i&7);
+
+    /* and check rows above and below for spans to fill */
+    if (((int)y>box.miny)&&(!pushRow(&f,minx,maxx,y-1))) err=SILERR_NOMEM;
+    if (((int)y+1<box.maxy)&&(!pushRow(&f,minx,maxx,y+1))) err=SILERR_NOMEM;
+  }
+  free(f.seen);
+  if (f.stack) free(f.stack);
+  return err;
 }
 
+
 /*****************************************************************************
 
-   Draw Pixel at x,y with current color and blend with existing pixels
+   Polygon rasterizer. Edges of all contours are walked scanline by
+   scanline and the exact area they cover in every pixel is accumulated 
+   in a row of floats. A running sum over that row gives the winding 
+   (with fractions at the edges) per pixel, which is turned into coverage
+   using the given fill rule and written as spans of equal coverage.
+   Every pixel is blended only once, whatever the number of edges. 
+
+   Coordinates are floats, so polygons can be placed on subpixels. Anything
+   outside layer is clipped. Contours are closed automatically.
 
  *****************************************************************************/
 
+typedef struct _GEDGE {
+  float x0,y0;
+  float y1;
+  float dxdy;
+  float dir;
+} GEDGE;
 
-void sil_blendPixel(SILLYR *layer, UINT x, UINT y) {
-  /* checks on validity of layer, fb and all is done in blendPixelLayer function already */
-  sil_blendPixelLayer(layer, x, y, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+static inline int floorint(float f) {
+  int i=(int)f;
+  return (f<i)?i-1:i;
+}
+
+static inline int ceilint(float f) {
+  int i=(int)f;
+  return (f>i)?i+1:i;
+}
+
+static int cmpEdge(const void *a, const void *b) {
+  float ya=((GEDGE *)a)->y0;
+  float yb=((GEDGE *)b)->y0;
+  return (ya<yb)?-1:((ya>yb)?1:0);
+}
+
+/* add area covered by part of an edge (from x to xnext, d high) within a single row */
+static void accumulate(float *acc, float x, float xnext, float d) {
+  float x0,x1,x0f,x1f,s,a0,a1,a2,am,xmf;
+  int x0i,x1i;
+
+  if (x<xnext) {
+    x0=x;
+    x1=xnext;
+  } else {
+    x0=xnext;
+    x1=x;
+  }
+  x0i=floorint(x0);
+  x1i=ceilint(x1);
+  if (x1i<=x0i+1) {
+    /* within one pixel */
+    xmf=0.5*(x+xnext)-x0i;
+    acc[x0i]+=d-d*xmf;
+    acc[x0i+1]+=d*xmf;
+    return;
+  }
+  s=1/(x1-x0);
+  x0f=x0-x0i;
+  a0=0.5*s*(1-x0f)*(1-x0f);
+  x1f=x1-x1i+1;
+  am=0.5*s*x1f*x1f;
+  acc[x0i]+=d*a0;
+  if (x1i==x0i+2) {
+    acc[x0i+1]+=d*(1-a0-am);
+  } else {
+    a1=s*(1.5-x0f);
+    acc[x0i+1]+=d*(a1-a0);
+    for (int xi=x0i+2;xi<x1i-1;xi++) acc[xi]+=d*s;
+    a2=a1+(x1i-x0i-3)*s;
+    acc[x1i-1]+=d*(1-a2-am);
+  }
+  acc[x1i]+=d*am;
+}
+
+/* write span with given coverage, in color or (if NULL) with background fill */
+static void fillRun(SILLYR *layer, int x, int y, int len, GCOLOR *color, UINT coverage) {
+  if (NULL==color) {
+    paintRow(layer,x,y,len,coverage);
+    return;
+  }
+  clipBlendRow(layer,x,y,len,color->red,color->green,color->blue,(coverage*color->alpha)/255);
 }
 
+static UINT rasterize(SILLYR *layer, SILPOINT *points, UINT *counts, UINT contours, BYTE rule, GCOLOR *color) {
+  GEDGE *edges=NULL;
+  UINT *active=NULL;
+  float *acc=NULL;
+  UINT cnt=0,total=0,next=0,nactive=0;
+  UINT width,height;
+  GBOX box;
+  SILPOINT *from,*to,*first;
+  float miny,maxy,top,bot,xa,xb,sum,cov;
+  int ystart,yend,minx,maxx,runx;
+  BYTE alpha,runalpha;
+
+  width=layer->fb->width;
+  height=layer->fb->height;
+  for (UINT c=0;c<contours;c++) total+=counts[c];
+  if ((total<3)||(!getClip(layer,&box))) return SILERR_ALLOK;
+
+  edges=malloc(total*sizeof(GEDGE));
+  active=malloc(total*sizeof(UINT));
+  acc=calloc(width+3,sizeof(float));
+  if ((NULL==edges)||(NULL==active)||(NULL==acc)) {
+    log_info("ERR: Can't allocate memory for polygon");
+    if (edges) free(edges);
+    if (active) free(active);
+    if (acc) free(acc);
+    return SILERR_NOMEM;
+  }
+
+  /* collect all non-horizontal edges, always pointing downwards */
+  miny=(float)height;
+  maxy=0;
+  first=points;
+  for (UINT c=0;c<contours;c++) {
+    for (UINT i=0;i<counts[c];i++) {
+      from=&first[i];
+      to=(i+1<counts[c])?&first[i+1]:first;
+      if (from->y==to->y) continue;
+      if (from->y<to->y) {
+        edges[cnt].x0=from->x;
+        edges[cnt].y0=from->y;
+        edges[cnt].y1=to->y;
+        edges[cnt].dir=1;
+      } else {
+        edges[cnt].x0=to->x;
+        edges[cnt].y0=to->y;
+        edges[cnt].y1=from->y;
+        edges[cnt].dir=-1;
+      }
+      edges[cnt].dxdy=(to->x-from->x)/(to->y-from->y);
+      if (edges[cnt].y0<miny) miny=edges[cnt].y0;
+      if (edges[cnt].y1>maxy) maxy=edges[cnt].y1;
+      cnt++;
+    }
+    first+=counts[c];
+  }
+  qsort(edges,cnt,sizeof(GEDGE),cmpEdge);
+
+  ystart=floorint(miny);
+  if (ystart<box.miny) ystart=box.miny;
+  yend=ceilint(maxy);
+  if (yend>box.maxy) yend=box.maxy;
+
+  for (int y=ystart;y<yend;y++) {
+
+    /* update list of edges crossing this row */
+    while ((next<cnt)&&(edges[next].y0<y+1)) active[nactive++]=next++;
+    for (UINT i=0;i<nactive;) {
+      if (edges[active[i]].y1<=y) {
+        active[i]=active[--nactive];
+      } else {
+        i++;
+      }
+    }
+    if (0==nactive) continue;
+
+    /* accumulate area of every part of an edge within this row */
+    minx=width;
+    maxx=0;
+    for (UINT i=0;i<nactive;i++) {
+      GEDGE *e=&edges[active[i]];
+      top=(e->y0>y)?e->y0:y;
+      bot=(e->y1<y+1)?e->y1:y+1;
+      if (bot<=top) continue;
+      xa=e->x0+(top-e->y0)*e->dxdy;
+      xb=e->x0+(bot-e->y0)*e->dxdy;
+      /* everything left of layer counts as being on left edge, right is ignored */
+      if (xa<0) xa=0;
+      if (xb<0) xb=0;
+      if (xa>width) xa=width;
+      if (xb>width) xb=width;
+      if (floorint((xa<xb)?xa:xb)<minx) minx=floorint((xa<xb)?xa:xb);
+      if (ceilint((xa>xb)?xa:xb)+1>maxx) maxx=ceilint((xa>xb)?xa:xb)+1;
+      accumulate(acc,xa,xb,(bot-top)*e->dir);
+    }
+    if (minx>maxx) continue;
+
+    /* walk the row, translating winding into coverage and writing spans */
+    sum=0;
+    runx=minx;
+    runalpha=0;
+    for (int x=minx;x<=maxx;x++) {
+      alpha=0;
+      if (x<(int)width) {
+        sum+=acc[x];
+        cov=(sum<0)?-sum:sum;
+        if (SILFILL_EVENODD==rule) {
+          cov-=2*(int)(cov/2);
+          if (cov>1) cov=2-cov;
+        } else {
+          if (cov>1) cov=1;
+        }
+        alpha=(BYTE)(cov*255+0.5);
+      }
+      if (alpha!=runalpha) {
+        if (runalpha) fillRun(layer,runx,y,x-runx,color,runalpha);
+        runx=x;
+        runalpha=alpha;
+      }
+    }
+    if (runalpha) fillRun(layer,runx,y,maxx+1-runx,color,runalpha);
+    memset(&acc[minx],0,(maxx-minx+1)*sizeof(float));
+  }
+
+  free(edges);
+  free(active);
+  free(acc);
+  return SILERR_ALLOK;
+}
 
 
 /*****************************************************************************
 
-   rescale layer to new width x height
+   Fill polygon with background color, anti-aliased. Points is an array of
+   count x,y coordinates (floats, relative to layer), last point connects 
+   to first point. Rule is SILFILL_NONZERO or SILFILL_EVENODD and decides 
+   what happens with overlapping or self-intersecting parts.
+
+   Returns SILERR_ALLOK or error
 
  *****************************************************************************/
 
-void sil_rescale(SILLYR *layer, UINT newwidth,UINT newheight) {
-  SILFB *tmpfb;
-  BYTE red,green,blue,alpha;
-  double scaleh,scalew;
+UINT sil_fillPolygon(SILLYR *layer, SILPOINT *points, UINT count, BYTE rule) {
+
+  if (gd.record) return recordPoints(GDL_PATH,points,&count,1,0,rule);
 
 #ifndef SIL_LIVEDANGEROUS
-  if (NULL==layer) {
-    log_warn("Trying to rescale non-existing layer");
-    return ;
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw polygon on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
   }
-  if (NULL==layer->fb) {
-    log_warn("Trying to rescale layer with no framebuffer");
-    return ;
+  if ((NULL==points)||(count<3)) {
+    log_warn("Polygon needs at least 3 points");
+    return SILERR_WRONGFORMAT;
   }
-  if (0==layer->fb->size) {
-    log_warn("Rescaling layer without initialized framebuffer");
-    return ;
+#endif
+  return rasterize(layer,points,&count,1,rule,NULL);
+}
+
+
+/*****************************************************************************
+
+   Fill path, made of multiple contours, with background color. Points 
+   holds the coordinates of all contours after each other, counts the 
+   number of points of every contour. Can be used for shapes with holes, 
+   like letters or rings. Rule is SILFILL_NONZERO or SILFILL_EVENODD.
+
+   Returns SILERR_ALLOK or error
+
+ *****************************************************************************/
+
+UINT sil_fillPath(SILLYR *layer, SILPOINT *points, UINT *counts, UINT contours, BYTE rule) {
+
+  if (gd.record) return recordPoints(GDL_PATH,points,counts,contours,0,rule);
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw path on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+  if ((NULL==points)||(NULL==counts)||(0==contours)) {
+    log_warn("Trying to draw empty path");
+    return SILERR_WRONGFORMAT;
   }
 #endif
-  /* no use to rescale with one of the dimensions "0", is it ? */
-  if ((0==newwidth)||(0==newheight)) {
+  return rasterize(layer,points,counts,contours,rule,NULL);
+}
+
+
+/*****************************************************************************
+
+   Stroker. Turns a polyline into polygons: a quad for every segment, a 
+   wedge for every join and a piece for every cap, all with the same 
+   orientation. These are rasterized together in one go with the non-zero
+   rule, so overlapping pieces don't get blended twice.
+
+ *****************************************************************************/
+
+#define GMITERLIMIT 4
+
+typedef struct _GSTROKE {
+  SILPOINT *points;
+  UINT npoints;
+  UINT sizepoints;
+  UINT *counts;
+  UINT ncounts;
+  UINT sizecounts;
+  UINT start;
+  BYTE err;
+} GSTROKE;
+
+/* square root of floats, without math.h */
+static float squarerootf(float number) {
+  float x=(number>1)?number:1;
+  float prev=0;
+
+  if (number<=0) return 0;
+  for (int i=0;(i<64)&&(x!=prev);i++) {
+    prev=x;
+    x=0.5*(x+number/x);
+  }
+  return x;
+}
+
+static void addPoint(GSTROKE *s, float x, float y) {
+  SILPOINT *new;
+
+  if (s->err) return;
+  if (s->npoints==s->sizepoints) {
+    new=realloc(s->points,(s->sizepoints?s->sizepoints*2:64)*sizeof(SILPOINT));
+    if (NULL==new) {
+      s->err=1;
+      return;
+    }
+    s->points=new;
+    s->sizepoints=s->sizepoints?s->sizepoints*2:64;
+  }
+  s->points[s->npoints].x=x;
+  s->points[s->npoints].y=y;
+  s->npoints++;
+}
+
+/* close current contour, turning it around if needed so all contours have same orientation */
+static void endContour(GSTROKE *s) {
+  UINT *new;
+  SILPOINT *p,tmp;
+  UINT cnt;
+  float area=0;
+
+  if (s->err) return;
+  p=&s->points[s->start];
+  cnt=s->npoints-s->start;
+  if (cnt<3) {
+    s->npoints=s->start;
     return;
   }
+  for (UINT i=0;i<cnt;i++) {
+    area+=p[i].x*p[(i+1)%cnt].y-p[(i+1)%cnt].x*p[i].y;
+  }
+  if (area<0) {
+    for (UINT i=0;i<cnt/2;i++) {
+      tmp=p[i];
+      p[i]=p[cnt-1-i];
+      p[cnt-1-i]=tmp;
+    }
+  }
+  if (s->ncounts==s->sizecounts) {
+    new=realloc(s->counts,(s->sizecounts?s->sizecounts*2:16)*sizeof(UINT));
+    if (NULL==new) {
+      s->err=1;
+      return;
+    }
+    s->counts=new;
+    s->sizecounts=s->sizecounts?s->sizecounts*2:16;
+  }
+  s->counts[s->ncounts++]=cnt;
+  s->start=s->npoints;
+}
 
-  /* create a temporary framebuffer for given width and height */
-  tmpfb=sil_initFB(newwidth,newheight,layer->fb->type);
+/* add points of arc around cx,cy from direction ax,ay to bx,by (both unit length), by halving */
+static void addArc(GSTROKE *s, float cx, float cy, float ax, float ay, float bx, float by, float r, int depth) {
+  float mx,my,len;
+
+  mx=ax+bx;
+  my=ay+by;
+  len=squarerootf(mx*mx+my*my);
+  /* stop when chord is close enough to arc, or directions are opposite */
+  if ((depth>8)||(len<0.0001)||(r*(1-len/2)<0.1)) {
+    addPoint(s,cx+bx*r,cy+by*r);
+    return;
+  }
+  mx/=len;
+  my/=len;
+  addArc(s,cx,cy,ax,ay,mx,my,r,depth+1);
+  addArc(s,cx,cy,mx,my,bx,by,r,depth+1);
+}
 
-  scalew=(double)newwidth/(double)layer->fb->width;
-  scaleh=(double)newheight/(double)layer->fb->height;
+/* half circle from normal nx,ny through outward direction dx,dy to the opposite normal */
+static void addRoundCap(GSTROKE *s, float cx, float cy, float nx, float ny, float dx, float dy, float hw) {
+  addPoint(s,cx,cy);
+  addPoint(s,cx+nx*hw,cy+ny*hw);
+  addArc(s,cx,cy,nx,ny,dx,dy,hw,0);
+  addArc(s,cx,cy,dx,dy,-nx,-ny,hw,0);
+  endContour(s);
+}
 
-  for (int y=0;y<newheight;y++) {
-    for (int x=0;x<newwidth;x++) {
-      sil_getPixelLayer(layer,(UINT)(x/scalew),(UINT)(y/scaleh),&red,&green,&blue,&alpha);
-      sil_putPixelFB(tmpfb,x,y,red,green,blue,alpha);
+static void addJoin(GSTROKE *s, SILPOINT *p, float nax, float nay, float nbx, float nby, float dbx, float dby, float hw) {
+  float side,dot,mx,my,k;
+
+  dot=nax*nbx+nay*nby;
+  if (dot>0.9999) return;
+  /* outer side of the bend is away from where the next segment turns to */
+  side=((dbx*nax+dby*nay)>0)?-1:1;
+  nax*=side;
+  nay*=side;
+  nbx*=side;
+  nby*=side;
+
+  if (SILJOIN_ROUND==gd.join) {
+    addPoint(s,p->x,p->y);
+    addPoint(s,p->x+nax*hw,p->y+nay*hw);
+    addArc(s,p->x,p->y,nax,nay,nbx,nby,hw,0);
+    endContour(s);
+    return;
+  }
+  addPoint(s,p->x,p->y);
+  addPoint(s,p->x+nax*hw,p->y+nay*hw);
+  if ((SILJOIN_MITER==gd.join)&&(dot>-0.9999)) {
+    /* miter point lies at hw/cos(angle/2), use it if within limit */
+    k=1/(1+dot);
+    if (2*k<=GMITERLIMIT*GMITERLIMIT) {
+      mx=(nax+nbx)*k;
+      my=(nay+nby)*k;
+      addPoint(s,p->x+mx*hw,p->y+my*hw);
     }
   }
+  addPoint(s,p->x+nbx*hw,p->y+nby*hw);
+  endContour(s);
+}
 
-  /* throw away old framebuffer */
-  free(layer->fb->buf);
-
-  /* and copy info from temp framebuffer in it */
-  layer->fb->buf=tmpfb->buf;
-  layer->fb->width=tmpfb->width;
-  layer->fb->height=tmpfb->height;
-  layer->fb->type=tmpfb->type;
-  layer->fb->size=tmpfb->size;
-  layer->view.minx=0;
-  layer->view.miny=0;
-  layer->view.width=tmpfb->width;
-  layer->view.height=tmpfb->height;
+static UINT strokePolyline(SILLYR *layer, SILPOINT *points, UINT count, BYTE closed, GCOLOR *color) {
+  GSTROKE s;
+  SILPOINT *pts=NULL;
+  UINT cnt=0,segs,ret;
+  float hw,dx,dy,len,nx,ny,pnx=0,pny=0,fnx=0,fny=0,fdx=0,fdy=0;
+  SILPOINT *a,*b;
+
+  if (gd.width<1) return SILERR_ALLOK;
+  hw=gd.width/2.0;
+
+  /* drop points that are on top of previous one */
+  pts=malloc((count+1)*sizeof(SILPOINT));
+  if (NULL==pts) {
+    log_info("ERR: Can't allocate memory for stroke");
+    return SILERR_NOMEM;
+  }
+  for (UINT i=0;i<count;i++) {
+    if ((cnt)&&(pts[cnt-1].x==points[i].x)&&(pts[cnt-1].y==points[i].y)) continue;
+    pts[cnt++]=points[i];
+  }
+  if ((closed)&&(cnt>2)&&(pts[cnt-1].x==pts[0].x)&&(pts[cnt-1].y==pts[0].y)) cnt--;
+  if ((closed)&&(cnt<3)) closed=0;
+
+  memset(&s,0,sizeof(GSTROKE));
+  if (1==cnt) {
+    /* just a dot, only visible with caps */
+    if (SILCAP_ROUND==gd.cap) {
+      addRoundCap(&s,pts[0].x,pts[0].y,0,-1,1,0,hw);
+      addRoundCap(&s,pts[0].x,pts[0].y,0,1,-1,0,hw);
+    }
+    if (SILCAP_SQUARE==gd.cap) {
+      addPoint(&s,pts[0].x-hw,pts[0].y-hw);
+      addPoint(&s,pts[0].x+hw,pts[0].y-hw);
+      addPoint(&s,pts[0].x+hw,pts[0].y+hw);
+      addPoint(&s,pts[0].x-hw,pts[0].y+hw);
+      endContour(&s);
+    }
+  }
 
-  
+  segs=closed?cnt:cnt-1;
+  for (UINT i=0;(cnt>1)&&(i<segs);i++) {
+    a=&pts[i];
+    b=&pts[(i+1)%cnt];
+    dx=b->x-a->x;
+    dy=b->y-a->y;
+    len=squarerootf(dx*dx+dy*dy);
+    dx/=len;
+    dy/=len;
+    nx=-dy;
+    ny=dx;
+
+    /* segment itself */
+    addPoint(&s,a->x+nx*hw,a->y+ny*hw);
+    addPoint(&s,b->x+nx*hw,b->y+ny*hw);
+    addPoint(&s,b->x-nx*hw,b->y-ny*hw);
+    addPoint(&s,a->x-nx*hw,a->y-ny*hw);
+    endContour(&s);
+
+    /* join with previous segment */
+    if (i>0) {
+      addJoin(&s,a,pnx,pny,nx,ny,dx,dy,hw);
+    } else {
+      fnx=nx;
+      fny=ny;
+      fdx=dx;
+      fdy=dy;
+      if (!closed) {
+        if (SILCAP_ROUND==gd.cap) addRoundCap(&s,a->x,a->y,nx,ny,-dx,-dy,hw);
+        if (SILCAP_SQUARE==gd.cap) {
+          addPoint(&s,a->x+nx*hw,a->y+ny*hw);
+          addPoint(&s,a->x-nx*hw,a->y-ny*hw);
+          addPoint(&s,a->x-(nx+dx)*hw,a->y-(ny+dy)*hw);
+          addPoint(&s,a->x+(nx-dx)*hw,a->y+(ny-dy)*hw);
+          endContour(&s);
+        }
+      }
+    }
+    if (i==segs-1) {
+      if (closed) {
+        addJoin(&s,b,nx,ny,fnx,fny,fdx,fdy,hw);
+      } else {
+        if (SILCAP_ROUND==gd.cap) addRoundCap(&s,b->x,b->y,nx,ny,dx,dy,hw);
+        if (SILCAP_SQUARE==gd.cap) {
+          addPoint(&s,b->x+nx*hw,b->y+ny*hw);
+          addPoint(&s,b->x-nx*hw,b->y-ny*hw);
+          addPoint(&s,b->x+(dx-nx)*hw,b->y+(dy-ny)*hw);
+          addPoint(&s,b->x+(dx+nx)*hw,b->y+(dy+ny)*hw);
+          endContour(&s);
+        }
+      }
+    }
+    pnx=nx;
+    pny=ny;
+  }
+  free(pts);
+
+  if (s.err) {
+    log_info("ERR: Can't allocate memory for stroke");
+    ret=SILERR_NOMEM;
+  } else {
+    ret=SILERR_ALLOK;
+    if (s.ncounts) ret=rasterize(layer,s.points,s.counts,s.ncounts,SILFILL_NONZERO,color);
+  }
+  if (s.points) free(s.points);
+  if (s.counts) free(s.counts);
+  return ret;
+}
+
+
+/*****************************************************************************
+
+   Draw polyline, anti-aliased, through count points (floats, relative to 
+   layer) with foreground color and drawing width. Segments are connected 
+   using join style (sil_setLineJoin) and ends get cap style (sil_setLineCap).
+   Pixel x,y spans from x to x+1, so use x+0.5 to hit middle of a pixel.
+   Whole line is blended only once, also where segments overlap.
+
+   Returns SILERR_ALLOK or error
+
+ *****************************************************************************/
+
+UINT sil_drawPolyline(SILLYR *layer, SILPOINT *points, UINT count) {
+
+  /* miters can stick out twice the drawing width */
+  if (gd.record) return recordPoints(GDL_POLYLINE,points,&count,1,2*gd.width,0);
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw polyline on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+  if ((NULL==points)||(0==count)) {
+    log_warn("Trying to draw polyline without points");
+    return SILERR_WRONGFORMAT;
+  }
+#endif
+  return strokePolyline(layer,points,count,0,&gd.fg);
+}
+
+
+/*****************************************************************************
+
+   Ellipses, circles, arcs and rounded rectangles, anti-aliased. Every row
+   of a shape is split into spans: full interior and full border spans are 
+   written using row fills, only pixels on the edges get their coverage 
+   computed. For curved edges that coverage comes from a lookup table, 
+   indexed by distance of the middle of the pixel to the edge.
+
+ *****************************************************************************/
+
+/* outer [0] and inner [1] shape: half width and height (radii for ellipse) */
+/* and radius of corners for rounded rectangles                             */
+typedef struct _GSHAPE {
+  BYTE rounded;
+  float cx,cy;
+  float w[2];
+  float h[2];
+  float r[2];
+} GSHAPE;
+
+/* sine of 0-90 degrees, so no math library is needed for arcs */
+static const float gsine[91]={
+  0.000000,0.017452,0.034899,0.052336,0.069756,0.087156,0.104528,0.121869,
+  0.139173,0.156434,0.173648,0.190809,0.207912,0.224951,0.241922,0.258819,
+  0.275637,0.292372,0.309017,0.325568,0.342020,0.358368,0.374607,0.390731,
+  0.406737,0.422618,0.438371,0.453990,0.469472,0.484810,0.500000,0.515038,
+  0.529919,0.544639,0.559193,0.573576,0.587785,0.601815,0.615661,0.629320,
+  0.642788,0.656059,0.669131,0.681998,0.694658,0.707107,0.719340,0.731354,
+  0.743145,0.754710,0.766044,0.777146,0.788011,0.798636,0.809017,0.819152,
+  0.829038,0.838671,0.848048,0.857167,0.866025,0.874620,0.882948,0.891007,
+  0.898794,0.906308,0.913545,0.920505,0.927184,0.933580,0.939693,0.945519,
+  0.951057,0.956305,0.961262,0.965926,0.970296,0.974370,0.978148,0.981627,
+  0.984808,0.987688,0.990268,0.992546,0.994522,0.996195,0.997564,0.998630,
+  0.999391,0.999848,1.000000
+};
+
+/* fill lookup table with part of pixel covered by an edge at given distance */
+/* from its middle, averaged over a couple of edge directions                 */
+static void initCoverage() {
+  float nx,ny,len,d;
+  UINT inside;
+
+  for (UINT i=0;i<GCOVSIZE;i++) {
+    d=(float)i/GCOVSTEPS-0.5;
+    inside=0;
+    for (UINT t=0;t<=4;t++) {
+      len=squarerootf(1+t*t/16.0);
+      nx=1/len;
+      ny=t/(4*len);
+      for (UINT sy=0;sy<8;sy++) {
+        for (UINT sx=0;sx<8;sx++) {
+          if (nx*((sx+0.5)/8-0.5)+ny*((sy+0.5)/8-0.5)<d) inside++;
+        }
+      }
+    }
+    gd.coverage[i]=(inside*255+160)/320;
+  }
+  gd.covinit=1;
+}
+
+/* coverage (0-255) of pixel by edge at distance d (positive is inside) */
+static UINT coverDistance(float d) {
+  if (d<=-0.5) return 0;
+  if (d>=0.5) return 255;
+  return gd.coverage[(int)((d+0.5)*GCOVSTEPS+0.5)];
+}
+
+/* coverage (0-255) of pixel x,y (relative to middle) by ellipse with radii a,b */
+static UINT coverEllipse(float x, float y, float a, float b) {
+  float f,gx,gy,g;
+
+  if ((a<=0)||(b<=0)) return 0;
+  gx=x/(a*a);
+  gy=y/(b*b);
+  f=x*gx+y*gy-1;
+  g=2*squarerootf(gx*gx+gy*gy);
+  if (g<0.0001) return 255;
+  return coverDistance(-f/g);
+}
+
+/* coverage (0-255) of pixel x,y (relative to middle) by rectangle with half */
+/* width w, half height h and rounded corners with radius r                  */
+static UINT coverRounded(float x, float y, float w, float h, float r) {
+  float qx,qy,cx,cy;
+
+  if ((w<=0)||(h<=0)) return 0;
+  if (x<0) x=-x;
+  if (y<0) y=-y;
+  qx=x-(w-r);
+  qy=y-(h-r);
+  if ((r>0)&&(qx>0)&&(qy>0)) return coverDistance(r-squarerootf(qx*qx+qy*qy));
+
+  /* straight edges, part of pixel within is exact */
+  cx=w-x+0.5;
+  cy=h-y+0.5;
+  if ((cx<=0)||(cy<=0)) return 0;
+  if (cx>1) cx=1;
+  if (cy>1) cy=1;
+  return (UINT)(cx*cy*255+0.5);
+}
+
+static UINT coverShape(GSHAPE *s, int i, float x, float y) {
+  if (s->rounded) return coverRounded(x,y,s->w[i],s->h[i],s->r[i]);
+  return coverEllipse(x,y,s->w[i],s->h[i]);
+}
+
+/* pixels in row whose middle is within h of cx, as [lo,hi], empty range is [c,c-1] */
+static void rowRange(float cx, float h, int *lo, int *hi) {
+  if (h>0) {
+    *lo=floorint(cx-h-0.5)+1;
+    *hi=ceilint(cx+h-0.5)-1;
+    if (*lo<=*hi) return;
+  }
+  *lo=floorint(cx);
+  *hi=*lo-1;
+}
+
+/* half width of outer (i=0) or inner (i=1) shape, grown by given amount, */
+/* at height y from middle. Returns -1 if row isn't crossing shape        */
+static float halfWidth(GSHAPE *s, int i, float y, float grow) {
+  float w,h,r,t;
+
+  w=s->w[i]+grow;
+  h=s->h[i]+grow;
+  if (y<0) y=-y;
+  if ((w<=0)||(h<=0)||(y>=h)) return -1;
+  if (s->rounded) {
+    r=s->r[i]+grow;
+    if (r<=0) return w;
+    if (r>w) r=w;
+    if (r>h) r=h;
+    if (y<=h-r) return w;
+    t=(y-(h-r))/r;
+    return w-r+r*squarerootf(1-t*t);
+  }
+  return w*squarerootf(1-(y*y)/(h*h));
+}
+
+/* pixels where outer and/or inner shape edge crosses. Part ci of pixel is */
+/* fill and co-ci is border; both are combined in a single color, so an     */
+/* opaque fill next to an opaque border gives an opaque pixel               */
+static void edgePixels(SILLYR *layer, GSHAPE *s, GBOX *box, int from, int to, int y) {
+  UINT co,ci,fa,ba,a;
+  float px,py;
+  GCOLOR f;
+
+  if (from<box->minx) from=box->minx;
+  if (to>=box->maxx) to=box->maxx-1;
+  py=y+0.5-s->cy;
+  for (int x=from;x<=to;x++) {
+    px=x+0.5-s->cx;
+    co=coverShape(s,0,px,py);
+    ci=coverShape(s,1,px,py);
+    if (ci>co) ci=co;
+    fa=0;
+    if (ci) {
+      fillColor(x,y,&f);
+      fa=ci*f.alpha;
+    }
+    ba=(co-ci)*gd.fg.alpha;
+    a=fa+ba;
+    if (0==a) continue;
+    if (0==fa) {
+      clipBlendPixel(layer,x,y,gd.fg.red,gd.fg.green,gd.fg.blue,a/255);
+    } else if (0==ba) {
+      clipBlendPixel(layer,x,y,f.red,f.green,f.blue,a/255);
+    } else {
+      clipBlendPixel(layer,x,y,(f.red*fa+gd.fg.red*ba)/a,(f.green*fa+gd.fg.green*ba)/a,
+          (f.blue*fa+gd.fg.blue*ba)/a,a/255);
+    }
+  }
+}
+
+/* draw shape with border (outer minus inner shape) in foreground color and */
+/* inside of inner shape in background color                                 */
+static void drawShapeAA(SILLYR *layer, GSHAPE *s) {
+  GBOX box;
+  float dy;
+  int ystart,yend;
+  int e0,e1,e2,e3,f0,f1,f2,f3;
+
+  if (!gd.covinit) initCoverage();
+  if (!getClip(layer,&box)) return;
+
+  ystart=floorint(s->cy-s->h[0]-1);
+  yend=ceilint(s->cy+s->h[0]+1);
+  if (ystart<box.miny) ystart=box.miny;
+  if (yend>box.maxy) yend=box.maxy;
+
+  for (int y=ystart;y<yend;y++) {
+    dy=y+0.5-s->cy;
+
+    /* ranges where pixels are touched by / completely within outer and inner shape */
+    rowRange(s->cx,halfWidth(s,0,dy,0.75),&e0,&f0);
+    if (e0>f0) continue;
+    rowRange(s->cx,halfWidth(s,0,dy,-0.75),&e1,&f1);
+    rowRange(s->cx,halfWidth(s,1,dy,0.75),&e2,&f2);
+    rowRange(s->cx,halfWidth(s,1,dy,-0.75),&e3,&f3);
+
+    /* make sure ranges nest, overlap will be handled as edge pixels */
+    if (e1<e0) e1=e0;
+    if (e2<e1) e2=e1;
+    if (e3<e2) e3=e2;
+    if (f2<f3) f2=f3;
+    if (f1<f2) f1=f2;
+    if (f0<f1) f0=f1;
+
+    /* shape can hang off the edges of layer, clamp spans while still signed */
+    if (e0<box.minx) e0=box.minx;
+    if (e1<box.minx) e1=box.minx;
+    if (e2<box.minx) e2=box.minx;
+    if (e3<box.minx) e3=box.minx;
+    if (f3>=box.maxx) f3=box.maxx-1;
+    if (f2>=box.maxx) f2=box.maxx-1;
+    if (f1>=box.maxx) f1=box.maxx-1;
+    if (f0>=box.maxx) f0=box.maxx-1;
+
+    edgePixels(layer,s,&box,e0,e1-1,y);
+    if ((e2>e1)&&(gd.fg.alpha)) clipBlendRow(layer,e1,y,e2-e1,gd.fg.red,gd.fg.green,gd.fg.blue,gd.fg.alpha);
+    edgePixels(layer,s,&box,e2,e3-1,y);
+    if ((f3>=e3)&&(hasFill())) paintRow(layer,e3,y,f3-e3+1,255);
+    edgePixels(layer,s,&box,f3+1,f2,y);
+    if ((f1>f2)&&(gd.fg.alpha)) clipBlendRow(layer,f2+1,y,f1-f2,gd.fg.red,gd.fg.green,gd.fg.blue,gd.fg.alpha);
+    edgePixels(layer,s,&box,f1+1,f0,y);
+  }
+}
+
+static void drawEllipseAA(SILLYR *layer, float cx, float cy, float a, float b) {
+  GSHAPE s;
+
+  /* border is centered on the edge, without border inner ellipse equals outer */
+  memset(&s,0,sizeof(GSHAPE));
+  s.cx=cx;
+  s.cy=cy;
+  s.w[0]=a+gd.width/2.0;
+  s.h[0]=b+gd.width/2.0;
+  s.w[1]=s.w[0]-gd.width;
+  s.h[1]=s.h[0]-gd.width;
+  drawShapeAA(layer,&s);
+}
+
+/* cosine and sine of angle in degrees */
+static void polar(int angle, float *c, float *s) {
+  angle%=360;
+  if (angle<0) angle+=360;
+  if (angle<=90) {
+    *c=gsine[90-angle];
+    *s=gsine[angle];
+  } else if (angle<=180) {
+    *c=-gsine[angle-90];
+    *s=gsine[180-angle];
+  } else if (angle<=270) {
+    *c=-gsine[270-angle];
+    *s=-gsine[angle-180];
+  } else {
+    *c=gsine[angle-270];
+    *s=-gsine[360-angle];
+  }
+}
+
+/* points on arc, one per degree, from start to end (clockwise), returns number of points */
+static UINT arcPoints(SILPOINT *points, float cx, float cy, float r, UINT start, UINT end) {
+  UINT cnt=0;
+  float c,s;
+
+  for (UINT angle=start;angle<=end;angle++) {
+    polar(angle,&c,&s);
+    points[cnt].x=cx+c*r;
+    points[cnt].y=cy+s*r;
+    cnt++;
+  }
+  return cnt;
+}
+
+
+/*****************************************************************************
+
+   Draw Ellipse Anti-Aliased with xm,ym being middle point and rx,ry the 
+   horizontal and vertical radius. Foreground = border (using drawing width, 
+   centered on the edge), background = fill. Parts outside layer are clipped.
+
+ *****************************************************************************/
+
+void sil_drawEllipseAA(SILLYR *layer, UINT xm, UINT ym, UINT rx, UINT ry) {
+
+  if (gd.record) {
+    recordRound(GDL_ELLIPSEAA,xm,ym,rx,ry,0,0);
+    return;
+  }
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw ellipse on non-existing layer or layer without framebuffer");
+    return ;
+  }
+  if ((0==rx)||(0==ry)) {
+    log_warn("Ellipse too small to draw on layer");
+    return ;
+  }
+#endif
+  drawEllipseAA(layer,xm+0.5,ym+0.5,rx,ry);
+}
+
+
+/*****************************************************************************
+
+   Draw Arc Anti-Aliased around xm,ym with radius r from angle start to end
+   in degrees. 0 degrees is at 3 o'clock, going clockwise. Arc is drawn 
+   with foreground color and drawing width, ends get cap style of 
+   sil_setLineCap.
+
+   Returns SILERR_ALLOK or error
+
+ *****************************************************************************/
+
+UINT sil_drawArcAA(SILLYR *layer, UINT xm, UINT ym, UINT r, UINT start, UINT end) {
+  SILPOINT points[361];
+  UINT cnt;
+
+  if (gd.record) return recordRound(GDL_ARCAA,xm,ym,r,r,start,end);
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw arc on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+#endif
+  start%=360;
+  end%=360;
+  if (end<=start) end+=360;
+  cnt=arcPoints(points,xm+0.5,ym+0.5,r,start,end);
+  return strokePolyline(layer,points,cnt,0,&gd.fg);
+}
+
+
+/*****************************************************************************
+
+   Draw Pie Anti-Aliased, part of a circle around xm,ym with radius r from 
+   angle start to end in degrees (0 is at 3 o'clock, going clockwise). It 
+   is filled with background color, border is drawn with foreground color
+   and drawing width.
+
+   Returns SILERR_ALLOK or error
+
+ *****************************************************************************/
+
+UINT sil_drawPieAA(SILLYR *layer, UINT xm, UINT ym, UINT r, UINT start, UINT end) {
+  SILPOINT points[362];
+  UINT cnt,err=SILERR_ALLOK;
+
+  if (gd.record) return recordRound(GDL_PIEAA,xm,ym,r,r,start,end);
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw pie on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+#endif
+  start%=360;
+  end%=360;
+  if (end<=start) end+=360;
+  points[0].x=xm+0.5;
+  points[0].y=ym+0.5;
+  cnt=1+arcPoints(&points[1],xm+0.5,ym+0.5,r,start,end);
+  if (hasFill()) err=rasterize(layer,points,&cnt,1,SILFILL_NONZERO,NULL);
+  if ((SILERR_ALLOK==err)&&(gd.fg.alpha)) err=strokePolyline(layer,points,cnt,1,&gd.fg);
+  return err;
+}
+
+
+/*****************************************************************************
+
+   Draw Rectangle with rounded, anti-aliased, corners at x,y using given width,
+   height and radius of corners. Foreground = border (using drawing width,
+   inside rectangle, like sil_drawRectangle), background = fill. 
+
+ *****************************************************************************/
+
+void sil_drawRoundedRect(SILLYR *layer, UINT x, UINT y, UINT width, UINT height, UINT radius) {
+  GSHAPE s;
+
+  if (gd.record) {
+    recordArgs(GDL_ROUNDEDRECT,x,y,x+width+1,y+height+1,x,y,width,height,radius,0);
+    return;
+  }
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw rounded rectangle on non-existing layer or layer without framebuffer");
+    return ;
+  }
+#endif
+  if ((0==width)||(0==height)) return;
+
+  memset(&s,0,sizeof(GSHAPE));
+  s.rounded=1;
+  s.cx=x+width/2.0;
+  s.cy=y+height/2.0;
+  s.w[0]=width/2.0;
+  s.h[0]=height/2.0;
+  s.r[0]=radius;
+  if (s.r[0]>s.w[0]) s.r[0]=s.w[0];
+  if (s.r[0]>s.h[0]) s.r[0]=s.h[0];
+  s.w[1]=s.w[0]-gd.width;
+  s.h[1]=s.h[0]-gd.width;
+  s.r[1]=s.r[0]-gd.width;
+  if (s.r[1]<0) s.r[1]=0;
+  drawShapeAA(layer,&s);
+}
+
+
+
+/*****************************************************************************
+
+   Draw Pixel at x,y with current color
+
+ *****************************************************************************/
+
+void sil_drawPixel(SILLYR *layer, UINT x, UINT y) {
+  if (gd.record) {
+    recordArgs(GDL_PIXEL,x,y,x+1,y+1,x,y,0,0,0,0);
+    return;
+  }
+  /* checks on validity of layer, fb and all is done in putPixelLayer function already */
+  clipPutPixel(layer, x, y, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+}
+
+/*****************************************************************************
+
+   Draw Pixel at x,y with current color and blend with existing pixels
+
+ *****************************************************************************/
+
+
+void sil_blendPixel(SILLYR *layer, UINT x, UINT y) {
+  if (gd.record) {
+    recordArgs(GDL_BLENDPIXEL,x,y,x+1,y+1,x,y,0,0,0,0);
+    return;
+  }
+  /* checks on validity of layer, fb and all is done in blendPixelLayer function already */
+  clipBlendPixel(layer, x, y, gd.fg.red, gd.fg.green, gd.fg.blue, gd.fg.alpha);
+}
+
+
+/*****************************************************************************
+
+   Replay all commands of display list on layer, with the drawing settings
+   they were recorded with. If area isn't NULL, only that part of layer 
+   will be drawn (for example, damaged area of the framebuffer of layer)
+   and all commands with bounding box outside it are skipped. Same goes 
+   for commands outside active clip rectangle. Drawing settings are kept
+   as they were before replay. Fonts used by text commands must still 
+   exist. If another list is being recorded, recording is suspended during
+   replay, so replayed commands are drawn on layer instead of being added
+   to that list.
+
+   Returns SILERR_ALLOK or error
+
+ *****************************************************************************/
+
+UINT sil_drawDisplayList(SILLYR *layer, SILDLIST *list, SILBOX *area) {
+  GCOLOR fg,bg;
+  GGRADIENT gradient;
+  UINT width;
+  BYTE join,cap;
+  GBOX box;
+  SILDCMD *cmd;
+  UINT err=SILERR_ALLOK;
+  SILDLIST *record;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("Trying to draw display list on non-existing layer or layer without framebuffer");
+    return SILERR_NOTINIT;
+  }
+  if (NULL==list) {
+    log_warn("Trying to draw non-existing display list");
+    return SILERR_NOTINIT;
+  }
+#endif
+
+  if (area) {
+    err=sil_pushClip(area->minx,area->miny,area->width,area->height);
+    if (SILERR_ALLOK!=err) return err;
+  }
+  record=gd.record;
+  gd.record=NULL;
+  fg=gd.fg;
+  bg=gd.bg;
+  gradient=gd.gradient;
+  width=gd.width;
+  join=gd.join;
+  cap=gd.cap;
+
+  for (UINT i=0;(i<list->cnt)&&(getClip(layer,&box));i++) {
+    cmd=&list->cmds[i];
+    if (GDL_NONE==cmd->kind) continue;
+
+    /* skip everything outside area to draw */
+    if ((cmd->box.maxx<=box.minx)||(cmd->box.minx>=box.maxx)||
+        (cmd->box.maxy<=box.miny)||(cmd->box.miny>=box.maxy)) continue;
+
+    gd.fg=cmd->fg;
+    gd.bg=cmd->bg;
+    if (memcmp(&gd.gradient,&cmd->gradient,sizeof(GGRADIENT))) {
+      gd.gradient=cmd->gradient;
+      gd.gradlut=0;
+    }
+    gd.width=cmd->width;
+    gd.join=cmd->join;
+    gd.cap=cmd->cap;
+    if ((cmd->hasclip)&&(SILERR_ALLOK!=sil_pushClip(cmd->clip.minx,cmd->clip.miny,cmd->clip.width,cmd->clip.height))) {
+      err=SILERR_NOMEM;
+      continue;
+    }
+    switch (cmd->kind) {
+      case GDL_LINE:
+        sil_drawLine(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[3]);
+        break;
+      case GDL_LINEAA:
+        sil_drawLineAA(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[3]);
+        break;
+      case GDL_CIRCLE:
+        sil_drawCircle(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2]);
+        break;
+      case GDL_CIRCLEAA:
+        sil_drawCircleAA(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2]);
+        break;
+      case GDL_ELLIPSEAA:
+        sil_drawEllipseAA(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[3]);
+        break;
+      case GDL_ARCAA:
+        sil_drawArcAA(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[4],cmd->arg[5]);
+        break;
+      case GDL_PIEAA:
+        sil_drawPieAA(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[4],cmd->arg[5]);
+        break;
+      case GDL_RECTANGLE:
+        sil_drawRectangle(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[3]);
+        break;
+      case GDL_ROUNDEDRECT:
+        sil_drawRoundedRect(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2],cmd->arg[3],cmd->arg[4]);
+        break;
+      case GDL_PATH:
+        sil_fillPath(layer,cmd->points,cmd->counts,cmd->arg[0],cmd->arg[1]);
+        break;
+      case GDL_POLYLINE:
+        sil_drawPolyline(layer,cmd->points,cmd->counts[0]);
+        break;
+      case GDL_PIXEL:
+        sil_drawPixel(layer,cmd->arg[0],cmd->arg[1]);
+        break;
+      case GDL_BLENDPIXEL:
+        sil_blendPixel(layer,cmd->arg[0],cmd->arg[1]);
+        break;
+      case GDL_TEXT:
+        sil_drawText(layer,cmd->font,cmd->text,cmd->arg[0],cmd->arg[1],cmd->arg[2]);
+        break;
+      case GDL_FLOODFILL:
+        sil_floodFill(layer,cmd->arg[0],cmd->arg[1],cmd->arg[2]);
+        break;
+    }
+    if (cmd->hasclip) sil_popClip();
+  }
+
+  gd.fg=fg;
+  gd.bg=bg;
+  if (memcmp(&gd.gradient,&gradient,sizeof(GGRADIENT))) {
+    gd.gradient=gradient;
+    gd.gradlut=0;
+  }
+  gd.width=width;
+  gd.join=join;
+  gd.cap=cap;
+  gd.record=record;
+  if (area) sil_popClip();
+  return err;
+}
+
+
+
+/*****************************************************************************
+  resampling filters for sil_rescale. Both directions are scaled separately,
+  using a precomputed table with (integer) weights per destination column or
+  row. Pixels are premultiplied with their alpha before filtering, so fully
+  transparent pixels don't bleed their color into the neighbours.
+
+ *****************************************************************************/
+
+/* fixed point precision of weights */
+#define GRESBITS   12
+#define GRESONE    (1<<GRESBITS)
+
+/* taps of one destination pixel, in table of weights */
+typedef struct _GTAPS {
+  int start;
+  UINT cnt;
+  UINT off;
+} GTAPS;
+
+typedef struct _GRESAXIS {
+  GTAPS *taps;
+  int *weights;
+  UINT maxcnt;
+} GRESAXIS;
+
+/* sin(PI*x), using Taylor series, so no need for math library */
+static float sinpi(float x) {
+  float u,u2;
+  int sign=1;
+  int n;
+
+  if (x<0) { x=-x; sign=-1; }
+  n=(int)x;
+  x-=n;
+  if (n&1) sign=-sign;
+  if (x>0.5) x=1-x;
+  u=x*3.14159265f;
+  u2=u*u;
+  u=u*(1-u2/6*(1-u2/20*(1-u2/42*(1-u2/72*(1-u2/110)))));
+  return sign*u;
+}
+
+/* filter kernel, x in source pixels (already divided by scaling) */
+static float kernel(BYTE filter, float x) {
+  if (x<0) x=-x;
+  switch(filter) {
+    case SILRESCALE_BILINEAR:
+      if (x<1) return 1-x;
+      return 0;
+    case SILRESCALE_LANCZOS:
+      if (x<0.00001) return 1;
+      if (x>=3) return 0;
+      return 3*sinpi(x)*sinpi(x/3)/(9.8696044f*x*x);
+  }
+  return 0;
+}
+
+static void freeAxis(GRESAXIS *axis) {
+  if (axis->taps) free(axis->taps);
+  if (axis->weights) free(axis->weights);
+  axis->taps=NULL;
+  axis->weights=NULL;
+}
+
+/*****************************************************************************
+  Calculate source pixels and their weights for every destination pixel 
+  along one axis. Returns 0 if out of memory
+
+ *****************************************************************************/
+
+static int initAxis(GRESAXIS *axis, BYTE filter, UINT from, UINT to) {
+  float scale=(float)from/(float)to;
+  float factor=(scale>1)?scale:1;
+  float support;
+  float center,lo,hi,w,sum;
+  float *wf;
+  int first,last,total,big;
+  UINT max,off,cnt;
+
+  memset(axis,0,sizeof(GRESAXIS));
+  switch(filter) {
+    case SILRESCALE_NEAREST:  support=0;  break;
+    case SILRESCALE_AREA:     support=(scale>1)?scale/2:0.5; factor=1; break;
+    case SILRESCALE_LANCZOS:  support=3*factor; break;
+    default:                  support=factor; break;
+  }
+
+  /* maximum amount of source pixels for a single destination pixel */
+  max=(UINT)(2*support)+3;
+  axis->taps=malloc(to*sizeof(GTAPS));
+  axis->weights=malloc(to*max*sizeof(int));
+  wf=malloc(max*sizeof(float));
+  if ((NULL==axis->taps)||(NULL==axis->weights)||(NULL==wf)) {
+    if (wf) free(wf);
+    freeAxis(axis);
+    return 0;
+  }
+
+  off=0;
+  for (UINT d=0;d<to;d++) {
+    center=(d+0.5)*scale;
+    if (SILRESCALE_NEAREST==filter) {
+      first=(int)center;
+      if (first>=(int)from) first=from-1;
+      axis->taps[d].start=first;
+      axis->taps[d].cnt=1;
+      axis->taps[d].off=off;
+      axis->weights[off++]=GRESONE;
+      if (axis->maxcnt<1) axis->maxcnt=1;
+      continue;
+    }
+    first=(int)(center-support+1)-1;
+    last=(int)(center+support+1)-1;
+    if (first<0) first=0;
+    if (last>=(int)from) last=from-1;
+    if (last-first+1>(int)max) last=first+max-1;
+
+    /* floating point weights of all source pixels in range */
+    sum=0;
+    cnt=0;
+    for (int i=first;i<=last;i++) {
+      if (SILRESCALE_AREA==filter) {
+        /* part of source pixel i covered by destination pixel */
+        lo=center-support;
+        hi=center+support;
+        if (lo<i) lo=i;
+        if (hi>i+1) hi=i+1;
+        w=(hi>lo)?hi-lo:0;
+      } else {
+        w=kernel(filter,(i+0.5-center)/factor);
+      }
+      wf[cnt++]=w;
+      sum+=w;
+    }
+    if (sum<=0) {
+      /* can only happen at far edges, just take nearest pixel */
+      for (UINT i=0;i<cnt;i++) wf[i]=0;
+      w=center-first;
+      if (w<0) w=0;
+      if (w>=cnt) w=cnt-1;
+      wf[(int)w]=1;
+      sum=1;
+    }
+
+    /* convert to fixed point, weights always add up to exactly GRESONE */
+    total=0;
+    big=0;
+    for (UINT i=0;i<cnt;i++) {
+      axis->weights[off+i]=(int)(wf[i]*GRESONE/sum+((wf[i]<0)?-0.5:0.5));
+      total+=axis->weights[off+i];
+      if (axis->weights[off+i]>axis->weights[off+big]) big=i;
+    }
+    axis->weights[off+big]+=GRESONE-total;
+
+    /* skip zero weights at both ends */
+    while ((cnt>1)&&(0==axis->weights[off])) {
+      for (UINT i=1;i<cnt;i++) axis->weights[off+i-1]=axis->weights[off+i];
+      first++;
+      cnt--;
+    }
+    while ((cnt>1)&&(0==axis->weights[off+cnt-1])) cnt--;
+
+    axis->taps[d].start=first;
+    axis->taps[d].cnt=cnt;
+    axis->taps[d].off=off;
+    if (cnt>axis->maxcnt) axis->maxcnt=cnt;
+    off+=cnt;
+  }
+  free(wf);
+  return 1;
+}
+
+/*****************************************************************************
+  Read one row of source framebuffer, scale it horizontally and store the
+  (premultiplied) result as 4 ints per destination pixel, in range 0-65025
+
+ *****************************************************************************/
+
+static void scaleRow(SILFB *fb, UINT y, GRESAXIS *axis, UINT width, int *src, int *dst) {
+  BYTE red,green,blue,alpha;
+  int r,g,b,a,w;
+  int *p;
+
+  for (UINT x=0;x<fb->width;x++) {
+    sil_getPixelFB(fb,x,y,&red,&green,&blue,&alpha);
+    src[x*4]  =red*alpha;
+    src[x*4+1]=green*alpha;
+    src[x*4+2]=blue*alpha;
+    src[x*4+3]=alpha*255;
+  }
+  for (UINT x=0;x<width;x++) {
+    r=g=b=a=0;
+    p=src+axis->taps[x].start*4;
+    for (UINT i=0;i<axis->taps[x].cnt;i++) {
+      w=axis->weights[axis->taps[x].off+i];
+      r+=p[0]*w;
+      g+=p[1]*w;
+      b+=p[2]*w;
+      a+=p[3]*w;
+      p+=4;
+    }
+    dst[x*4]  =r>>GRESBITS;
+    dst[x*4+1]=g>>GRESBITS;
+    dst[x*4+2]=b>>GRESBITS;
+    dst[x*4+3]=a>>GRESBITS;
+  }
+}
+
+/* from premultiplied to normal color value */
+static BYTE unpremultiply(int value, int alpha) {
+  if (value<=0) return 0;
+  value=(value+alpha/2)/alpha;
+  if (value>255) return 255;
+  return value;
+}
+
+/*****************************************************************************
+  setter & getter for filter used by sil_rescale 
+
+ *****************************************************************************/
+
+void sil_setRescaleFilter(BYTE filter) {
+  gd.rescale=filter;
+}
+
+BYTE sil_getRescaleFilter() {
+  return gd.rescale;
+}
+
+/*****************************************************************************
+
+   rescale layer to new width x height, using filter set by 
+   sil_setRescaleFilter (default SILRESCALE_BILINEAR). When shrinking, the
+   bilinear and lanczos filters are widened, so all source pixels are used.
+   Layers with a colorkey always use nearest neighbour, to keep transparent
+   pixels exactly the color of the key.
+
+ *****************************************************************************/
+
+void sil_rescale(SILLYR *layer, UINT newwidth,UINT newheight) {
+  SILFB *tmpfb;
+  GRESAXIS horz,vert;
+  BYTE filter;
+  int *src=NULL;
+  int *rows=NULL;
+  int *ringrow=NULL;
+  int *line;
+  int r,g,b,a,w;
+  UINT ring,slot;
+  BYTE alpha;
+
+#ifndef SIL_LIVEDANGEROUS
+  if (NULL==layer) {
+    log_warn("Trying to rescale non-existing layer");
+    return ;
+  }
+  if (NULL==layer->fb) {
+    log_warn("Trying to rescale layer with no framebuffer");
+    return ;
+  }
+  if (0==layer->fb->size) {
+    log_warn("Rescaling layer without initialized framebuffer");
+    return ;
+  }
+#endif
+  /* no use to rescale with one of the dimensions "0", is it ? */
+  if ((0==newwidth)||(0==newheight)) {
+    return;
+  }
+
+  /* nine-slice layers are drawn at any size, no need for scaling pixels */
+  if (layer->fb->slice) {
+    sil_resizeNineSlice(layer,newwidth,newheight);
+    return;
+  }
+
+  if (NULL==layer->fb->buf) {
+    log_warn("rescaling layer without a buffer of its own (tiled, tilemap, ...) isn't possible");
+    return;
+  }
+
+  /* create a temporary framebuffer for given width and height */
+  /* that will replace the buffer, so it must be in place     */
+  sil_unwrapFB(layer->fb);
+  tmpfb=sil_initFB(newwidth,newheight,layer->fb->type);
+  if (NULL==tmpfb) {
+    log_info("ERR: Can't create temporary framebuffer for rescaling");
+    return;
+  }
+
+  filter=gd.rescale;
+  if (layer->fb->colorkey) filter=SILRESCALE_NEAREST;
+  if (!initAxis(&horz,filter,layer->fb->width,newwidth)) {
+    log_info("ERR: Can't allocate memory for rescaling");
+    sil_destroyFB(tmpfb);
+    return;
+  }
+  if (!initAxis(&vert,filter,layer->fb->height,newheight)) {
+    log_info("ERR: Can't allocate memory for rescaling");
+    freeAxis(&horz);
+    sil_destroyFB(tmpfb);
+    return;
+  }
+
+  /* horizontally scaled source rows are kept in a ring, big enough for */
+  /* all taps of a destination row, so every row is only scaled once    */
+  ring=vert.maxcnt;
+  src=malloc(layer->fb->width*4*sizeof(int));
+  rows=malloc(ring*newwidth*4*sizeof(int));
+  ringrow=malloc(ring*sizeof(int));
+  if ((NULL==src)||(NULL==rows)||(NULL==ringrow)) {
+    log_info("ERR: Can't allocate memory for rescaling");
+    if (src) free(src);
+    if (rows) free(rows);
+    if (ringrow) free(ringrow);
+    freeAxis(&horz);
+    freeAxis(&vert);
+    sil_destroyFB(tmpfb);
+    return;
+  }
+  for (UINT i=0;i<ring;i++) ringrow[i]=-1;
+
+  for (UINT y=0;y<newheight;y++) {
+    GTAPS *taps=&vert.taps[y];
+
+    for (UINT i=0;i<taps->cnt;i++) {
+      slot=(taps->start+i)%ring;
+      if (ringrow[slot]!=taps->start+(int)i) {
+        scaleRow(layer->fb,taps->start+i,&horz,newwidth,src,rows+slot*newwidth*4);
+        ringrow[slot]=taps->start+i;
+      }
+    }
+    for (UINT x=0;x<newwidth;x++) {
+      r=g=b=a=0;
+      for (UINT i=0;i<taps->cnt;i++) {
+        line=rows+((taps->start+i)%ring)*newwidth*4+x*4;
+        w=vert.weights[taps->off+i];
+        r+=line[0]*w;
+        g+=line[1]*w;
+        b+=line[2]*w;
+        a+=line[3]*w;
+      }
+      r>>=GRESBITS;
+      g>>=GRESBITS;
+      b>>=GRESBITS;
+      a>>=GRESBITS;
+      if (a<=127) {
+        sil_putPixelFB(tmpfb,x,y,0,0,0,0);
+        continue;
+      }
+      if (a>65025) a=65025;
+      alpha=(a+127)/255;
+      sil_putPixelFB(tmpfb,x,y,unpremultiply(r,alpha),unpremultiply(g,alpha),
+        unpremultiply(b,alpha),alpha);
+    }
+  }
+  free(src);
+  free(rows);
+  free(ringrow);
+  freeAxis(&horz);
+  freeAxis(&vert);
+
+  /* throw away old framebuffer */
+  free(layer->fb->buf);
+
+  /* and copy info from temp framebuffer in it */
+  layer->fb->buf=tmpfb->buf;
+  layer->fb->width=tmpfb->width;
+  layer->fb->height=tmpfb->height;
+  layer->fb->type=tmpfb->type;
+  layer->fb->size=tmpfb->size;
+  layer->fb->changed=1;
+  layer->fb->version++;
+  layer->fb->resized=1;
+  layer->view.minx=0;
+  layer->view.miny=0;
+  layer->view.width=tmpfb->width;
+  layer->view.height=tmpfb->height;
+  sil_updateIndex(layer);
+
+  /* buffer is now owned by layer, only throw away the temporary struct */
+  free(tmpfb);
 }
 
 #endif
@@ -60,6 +60,7 @@ UINT sil_cropAlphaFilter(SILLYR *layer) {
   layer->view.height=layer->fb->height;
   layer->view.minx=0;
   layer->view.miny=0;
+  sil_updateIndex(layer);
   layer->fb->resized=1;
 
   return err;
@@ -97,6 +98,7 @@ UINT sil_cropFirstpixelFilter(SILLYR *layer) {
   layer->view.height=layer->fb->height;
   layer->view.minx=0;
   layer->view.miny=0;
+  sil_updateIndex(layer);
 
 
   return err;
@@ -165,8 +167,14 @@ UINT sil_blurFilter(SILLYR *layer ) {
   if (SILERR_ALLOK!=err) return err;
 #endif
 
-  /* for this, we need to create a seperate FB temporary */
+  if (NULL==layer->fb->buf) {
+    log_warn("blur filter on layer without a buffer of its own (tiled, tilemap, ...) isn't possible");
+    return SILERR_WRONGFORMAT;
+  }
 
+  /* for this, we need to create a seperate FB temporary */
+  /* that will replace the buffer, so it must be in place */
+  sil_unwrapFB(layer->fb);
   dest=sil_initFB(layer->fb->width,layer->fb->height,layer->fb->type);
   if (NULL==dest) {
     log_info("ERR: Cant create framebuffer for blur filter");
@@ -264,6 +272,7 @@ UINT sil_blurFilter(SILLYR *layer ) {
   /* swap framebuffers and remove the old one */
   if (layer->fb->buf) free(layer->fb->buf);
   layer->fb->buf=dest->buf;
+  layer->fb->version++;
   
   return err;
 }
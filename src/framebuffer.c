@@ -17,6 +17,1103 @@
 #include "sil_int.h"
 
 
+/*****************************************************************************
+
+  Tiled framebuffers
+
+  For very large (virtual) framebuffers, pixels are kept in tiles of 
+  SILTILE_SIZE x SILTILE_SIZE pixels, each a normal framebuffer. Tiles are 
+  only created when a pixel is written to them, or when a loader function 
+  has been set, when pixels of it are read for the first time. Reading pixels 
+  of tiles that don't exist returns transparent black.
+
+  Tiles are kept in a hashtable on column & row, the last used tile is 
+  remembered, since pixels are mostly read and written in rows.
+
+ *****************************************************************************/
+
+#define SILTILE_SHIFT 8
+#define SILTILE_SIZE  (1<<SILTILE_SHIFT)
+
+typedef struct _SILTILE {
+  UINT col;
+  UINT row;
+  SILFB *fb;        /* NULL if loader had nothing to offer for this tile */
+  BYTE used;
+} SILTILE;
+
+typedef struct _SILTILES {
+  SILTILE *slot;
+  UINT size;        /* amount of slots, always power of 2 */
+  UINT used;
+  /* last tile used */
+  UINT lastcol;
+  UINT lastrow;
+  SILFB *lastfb;
+  BYTE lastvalid;
+  /* optional function supplying tiles */
+  UINT (*loader)(struct _SILLYR *, SILFB *, UINT, UINT);
+  struct _SILLYR *owner;
+} SILTILES;
+
+static inline UINT tileSlot(SILTILES *tiles, UINT col, UINT row) {
+  return (col*73856093u ^ row*19349663u)&(tiles->size-1);
+}
+
+static void freeTiles(SILTILES *tiles) {
+  for (UINT i=0;i<tiles->size;i++) {
+    if (tiles->slot[i].fb) sil_destroyFB(tiles->slot[i].fb);
+  }
+  memset(tiles->slot,0,tiles->size*sizeof(SILTILE));
+  tiles->used=0;
+  tiles->lastvalid=0;
+}
+
+static SILTILE *findTile(SILTILES *tiles, UINT col, UINT row) {
+  UINT i=tileSlot(tiles,col,row);
+
+  while (tiles->slot[i].used) {
+    if ((tiles->slot[i].col==col)&&(tiles->slot[i].row==row)) return &tiles->slot[i];
+    i=(i+1)&(tiles->size-1);
+  }
+  return NULL;
+}
+
+static SILTILE *insertTile(SILTILES *tiles, UINT col, UINT row, SILFB *fb) {
+  SILTILE *old;
+  UINT oldsize;
+  UINT i;
+
+  if ((tiles->used+1)*2>tiles->size) {
+    old=tiles->slot;
+    oldsize=tiles->size;
+    tiles->slot=calloc(oldsize*2,sizeof(SILTILE));
+    if (NULL==tiles->slot) {
+      log_info("ERR: Can't allocate memory for list of tiles");
+      tiles->slot=old;
+      return NULL;
+    }
+    tiles->size=oldsize*2;
+    tiles->used=0;
+    for (i=0;i<oldsize;i++) {
+      if (old[i].used) insertTile(tiles,old[i].col,old[i].row,old[i].fb);
+    }
+    free(old);
+  }
+  i=tileSlot(tiles,col,row);
+  while (tiles->slot[i].used) i=(i+1)&(tiles->size-1);
+  tiles->slot[i].used=1;
+  tiles->slot[i].col=col;
+  tiles->slot[i].row=row;
+  tiles->slot[i].fb=fb;
+  tiles->used++;
+  return &tiles->slot[i];
+}
+
+/* get tile for given column and row, creating one if 'create' is set */
+static SILFB *getTile(SILFB *fb, UINT col, UINT row, BYTE create) {
+  SILTILES *tiles=fb->tiles;
+  SILTILE *tile;
+  SILFB *new=NULL;
+
+  if ((tiles->lastvalid)&&(tiles->lastcol==col)&&(tiles->lastrow==row)) {
+    if ((tiles->lastfb)||(!create)) return tiles->lastfb;
+  }
+
+  tile=findTile(tiles,col,row);
+  if ((NULL==tile)&&(tiles->loader)) {
+    /* first time this tile is needed, ask for its content */
+    new=sil_initFB(SILTILE_SIZE,SILTILE_SIZE,fb->type);
+    if (new) {
+      if ((0==tiles->loader(tiles->owner,new,col,row))&&(!create)) {
+        sil_destroyFB(new);
+        new=NULL;
+      }
+    }
+    tile=insertTile(tiles,col,row,new);
+    if (NULL==tile) {
+      /* can't remember it, so don't hand out a tile nobody will free */
+      if (new) sil_destroyFB(new);
+      tiles->lastvalid=0;
+      return NULL;
+    }
+  }
+  if ((create)&&((NULL==tile)||(NULL==tile->fb))) {
+    new=sil_initFB(SILTILE_SIZE,SILTILE_SIZE,fb->type);
+    if (NULL==new) return NULL;
+    if (tile) {
+      tile->fb=new;
+    } else {
+      tile=insertTile(tiles,col,row,new);
+      if (NULL==tile) {
+        sil_destroyFB(new);
+        return NULL;
+      }
+    }
+  }
+  tiles->lastcol=col;
+  tiles->lastrow=row;
+  tiles->lastfb=tile?tile->fb:NULL;
+  tiles->lastvalid=1;
+  return tiles->lastfb;
+}
+
+static void putPixelTiles(SILFB *fb, UINT x, UINT y, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  SILFB *tile;
+
+  if ((x>=fb->width)||(y>=fb->height)) return;
+  tile=getTile(fb,x>>SILTILE_SHIFT,y>>SILTILE_SHIFT,1);
+  if (NULL==tile) return;
+  sil_putPixelFB(tile,x&(SILTILE_SIZE-1),y&(SILTILE_SIZE-1),red,green,blue,alpha);
+  fb->changed=1;
+  fb->version++;
+}
+
+static void getPixelTiles(SILFB *fb, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  SILFB *tile=NULL;
+
+  if ((x<fb->width)&&(y<fb->height)) tile=getTile(fb,x>>SILTILE_SHIFT,y>>SILTILE_SHIFT,0);
+  if (NULL==tile) {
+    *red=0;
+    *green=0;
+    *blue=0;
+    *alpha=0;
+    return;
+  }
+  sil_getPixelFB(tile,x&(SILTILE_SIZE-1),y&(SILTILE_SIZE-1),red,green,blue,alpha);
+}
+
+
+/*****************************************************************************
+  Initialize tiled framebuffer
+  In: width & height of (virtual) framebuffer + RGB format
+
+  Same as sil_initFB, however no pixels are allocated yet. This is done per 
+  tile (SILTILE_SIZE x SILTILE_SIZE pixels) when needed. 
+
+ *****************************************************************************/
+
+SILFB *sil_initTiledFB(UINT width, UINT height, BYTE type) {
+  SILFB *fb;
+  SILFB *probe;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((0==width)||(0==height)||(0==type)||(SILTYPE_EMPTY==type)) {
+      log_warn("can't initialize tiled framebuffer; One or more parameters are zero or empty type");
+      return NULL;
+  }
+#endif
+
+  /* create a single pixel framebuffer, to check type and get bytes needed */
+  probe=sil_initFB(1,1,type);
+  if (NULL==probe) return NULL;
+  sil_destroyFB(probe);
+
+  fb=calloc(1,sizeof(SILFB));
+  if (NULL==fb) {
+    log_info("ERR: Can't allocate memory for framebuffer struct");
+    return NULL;
+  }
+  fb->tiles=calloc(1,sizeof(SILTILES));
+  if (NULL==fb->tiles) {
+    free(fb);
+    log_info("ERR: Can't allocate memory for tiles of framebuffer");
+    return NULL;
+  }
+  fb->tiles->size=64;
+  fb->tiles->slot=calloc(fb->tiles->size,sizeof(SILTILE));
+  if (NULL==fb->tiles->slot) {
+    free(fb->tiles);
+    free(fb);
+    log_info("ERR: Can't allocate memory for tiles of framebuffer");
+    return NULL;
+  }
+  fb->buf=NULL;
+  if (sil_bytesFB(type)) {
+    fb->size=(uint64_t)width*height*sil_bytesFB(type);
+  } else {
+    fb->size=1+(uint64_t)width*height*3/2;
+  }
+  fb->width=width;
+  fb->height=height;
+  fb->type=type;
+  fb->changed=1;
+  fb->resized=0;
+  return fb;
+}
+
+/*****************************************************************************
+  Set function that will be called the first time a tile is needed. 
+  function gets the given owner, an empty tile framebuffer and column and 
+  row of tile and should return 1 if it has drawn into tile, or 0 if tile 
+  can be left empty.
+
+  In: tiled SILFB framebuffer context, function, owner (layer) to pass 
+ *****************************************************************************/
+
+void sil_setTileLoaderFB(SILFB *fb, UINT (*loader)(struct _SILLYR *, SILFB *, UINT, UINT), struct _SILLYR *owner) {
+  if ((NULL==fb)||(NULL==fb->tiles)) {
+    log_warn("trying to set tile loader on a non-tiled FB ");
+    return;
+  }
+  fb->tiles->loader=loader;
+  fb->tiles->owner=owner;
+  fb->tiles->lastvalid=0;
+}
+
+
+/*****************************************************************************
+
+  Tilemap framebuffers
+
+  Pixels of a tilemap framebuffer aren't stored, but taken from a tileset: 
+  another framebuffer with tiles of tilew x tileh pixels, numbered from left 
+  to right, top to bottom. A grid of cols x rows cells holds the index of the 
+  tile shown in each cell, or SILMAP_NONE for an empty (transparent) cell. 
+
+  In repeat mode, framebuffer can be larger then the grid, which is then 
+  repeated over the whole framebuffer (for tiled backgrounds).
+
+  Writing pixels to a tilemap framebuffer is ignored, change cells instead.
+
+ *****************************************************************************/
+
+typedef struct _SILMAP {
+  SILFB *tileset;   /* not owned, belongs to a layer of its own */
+  UINT tilew;
+  UINT tileh;
+  UINT cols;
+  UINT rows;
+  UINT perrow;      /* amount of tiles in a row of tileset */
+  UINT count;       /* amount of tiles in tileset          */
+  UINT *cell;
+  BYTE repeat;
+} SILMAP;
+
+static void getPixelMap(SILFB *fb, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  SILMAP *map=fb->map;
+  UINT col,row,idx;
+
+  idx=SILMAP_NONE;
+  if ((x<fb->width)&&(y<fb->height)) {
+    col=x/map->tilew;
+    row=y/map->tileh;
+    if (map->repeat) {
+      col%=map->cols;
+      row%=map->rows;
+    }
+    if ((col<map->cols)&&(row<map->rows)) idx=map->cell[row*map->cols+col];
+  }
+  if (SILMAP_NONE==idx) {
+    *red=0;
+    *green=0;
+    *blue=0;
+    *alpha=0;
+    return;
+  }
+  sil_getPixelFB(map->tileset,(idx%map->perrow)*map->tilew+x%map->tilew,
+      (idx/map->perrow)*map->tileh+y%map->tileh,red,green,blue,alpha);
+}
+
+
+/*****************************************************************************
+  Initialize tilemap framebuffer
+  In: tileset framebuffer, width & height of a single tile, amount of 
+      columns and rows of grid. All cells start empty (SILMAP_NONE)
+ *****************************************************************************/
+
+SILFB *sil_initMapFB(SILFB *tileset, UINT tilew, UINT tileh, UINT cols, UINT rows) {
+  SILFB *fb;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==tileset)||(0==tileset->size)||(0==tilew)||(0==tileh)||(0==cols)||(0==rows)) {
+    log_warn("can't initialize tilemap framebuffer; missing tileset or one or more parameters are zero");
+    return NULL;
+  }
+  if ((tilew>tileset->width)||(tileh>tileset->height)) {
+    log_warn("can't initialize tilemap framebuffer; tiles are larger then tileset");
+    return NULL;
+  }
+#endif
+
+  fb=calloc(1,sizeof(SILFB));
+  if (NULL==fb) {
+    log_info("ERR: Can't allocate memory for framebuffer struct");
+    return NULL;
+  }
+  fb->map=calloc(1,sizeof(SILMAP));
+  if (NULL==fb->map) {
+    free(fb);
+    log_info("ERR: Can't allocate memory for tilemap of framebuffer");
+    return NULL;
+  }
+  fb->map->cell=malloc((uint64_t)cols*rows*sizeof(UINT));
+  if (NULL==fb->map->cell) {
+    free(fb->map);
+    free(fb);
+    log_info("ERR: Can't allocate memory for cells of tilemap");
+    return NULL;
+  }
+  /* all bytes 0xFF == SILMAP_NONE */
+  memset(fb->map->cell,0xFF,(uint64_t)cols*rows*sizeof(UINT));
+  fb->map->tileset=tileset;
+  fb->map->tilew=tilew;
+  fb->map->tileh=tileh;
+  fb->map->cols=cols;
+  fb->map->rows=rows;
+  fb->map->perrow=tileset->width/tilew;
+  fb->map->count=fb->map->perrow*(tileset->height/tileh);
+  fb->buf=NULL;
+  fb->width=cols*tilew;
+  fb->height=rows*tileh;
+  fb->type=tileset->type;
+  fb->size=(uint64_t)fb->width*fb->height*SIL_MAX(1,sil_bytesFB(fb->type));
+  fb->changed=1;
+  fb->resized=0;
+  return fb;
+}
+
+
+/*****************************************************************************
+  Set tile index of a single cell of tilemap framebuffer, only the area of 
+  that cell is marked as damaged.
+
+  In: tilemap SILFB framebuffer context, column & row of cell, tile index
+  Out: SILERR_ALLOK or SILERR_WRONGFORMAT if cell or index is out of range
+ *****************************************************************************/
+
+UINT sil_setCellFB(SILFB *fb, UINT col, UINT row, UINT index) {
+  SILMAP *map;
+
+  if ((NULL==fb)||(NULL==fb->map)) {
+    log_warn("trying to set cell of a non-tilemap FB ");
+    return SILERR_NOTINIT;
+  }
+  map=fb->map;
+  if ((col>=map->cols)||(row>=map->rows)||((SILMAP_NONE!=index)&&(index>=map->count))) {
+    log_warn("cell %d,%d or tile index %d outside of tilemap",col,row,index);
+    return SILERR_WRONGFORMAT;
+  }
+  if (map->cell[row*map->cols+col]==index) return SILERR_ALLOK;
+  map->cell[row*map->cols+col]=index;
+  fb->version++;
+  if (map->repeat) {
+    /* cell shows up multiple times */
+    fb->changed=1;
+  } else {
+    sil_damageFB(fb,col*map->tilew,row*map->tileh,map->tilew,map->tileh);
+  }
+  return SILERR_ALLOK;
+}
+
+
+/*****************************************************************************
+  Get tile index of a cell of tilemap framebuffer
+  In: tilemap SILFB framebuffer context, column & row of cell
+  Out: tile index or SILMAP_NONE if empty or out of range
+ *****************************************************************************/
+
+UINT sil_getCellFB(SILFB *fb, UINT col, UINT row) {
+  if ((NULL==fb)||(NULL==fb->map)) {
+    log_warn("trying to get cell of a non-tilemap FB ");
+    return SILMAP_NONE;
+  }
+  if ((col>=fb->map->cols)||(row>=fb->map->rows)) return SILMAP_NONE;
+  return fb->map->cell[row*fb->map->cols+col];
+}
+
+
+/*****************************************************************************
+  Get cell (and its tile index) of tilemap framebuffer at given pixel 
+  position, taking repeat mode into account.
+
+  In: tilemap SILFB framebuffer context, x,y within framebuffer, pointers to 
+      store column and row of cell (can be NULL)
+  Out: tile index or SILMAP_NONE if empty or outside of grid
+ *****************************************************************************/
+
+UINT sil_cellAtFB(SILFB *fb, UINT x, UINT y, UINT *col, UINT *row) {
+  SILMAP *map;
+  UINT c,r;
+
+  if ((NULL==fb)||(NULL==fb->map)||(x>=fb->width)||(y>=fb->height)) return SILMAP_NONE;
+  map=fb->map;
+  c=x/map->tilew;
+  r=y/map->tileh;
+  if (map->repeat) {
+    c%=map->cols;
+    r%=map->rows;
+  }
+  if ((c>=map->cols)||(r>=map->rows)) return SILMAP_NONE;
+  if (col) *col=c;
+  if (row) *row=r;
+  return map->cell[r*map->cols+c];
+}
+
+
+/*****************************************************************************
+  Set all cells of tilemap framebuffer to given tile index
+  In: tilemap SILFB framebuffer context, tile index or SILMAP_NONE
+ *****************************************************************************/
+
+void sil_fillCellsFB(SILFB *fb, UINT index) {
+  SILMAP *map;
+
+  if ((NULL==fb)||(NULL==fb->map)) {
+    log_warn("trying to fill cells of a non-tilemap FB ");
+    return;
+  }
+  map=fb->map;
+  if ((SILMAP_NONE!=index)&&(index>=map->count)) {
+    log_warn("tile index %d outside of tileset",index);
+    return;
+  }
+  for (UINT i=0;i<map->cols*map->rows;i++) map->cell[i]=index;
+  fb->changed=1;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+  Switch repeat mode of tilemap framebuffer on or off. 
+
+  In: tilemap SILFB framebuffer context, width & height of framebuffer to 
+      cover with repeated grid, or 0,0 to turn repeat mode off and go back
+      to size of grid itself.
+ *****************************************************************************/
+
+void sil_repeatMapFB(SILFB *fb, UINT width, UINT height) {
+  SILMAP *map;
+
+  if ((NULL==fb)||(NULL==fb->map)) {
+    log_warn("trying to repeat a non-tilemap FB ");
+    return;
+  }
+  map=fb->map;
+  if ((0==width)||(0==height)) {
+    map->repeat=0;
+    width=map->cols*map->tilew;
+    height=map->rows*map->tileh;
+  } else {
+    map->repeat=1;
+  }
+  fb->width=width;
+  fb->height=height;
+  fb->size=(uint64_t)width*height*SIL_MAX(1,sil_bytesFB(fb->type));
+  fb->changed=1;
+  fb->resized=1;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+
+  Batch framebuffers
+
+  Like tilemaps, pixels of a batch framebuffer aren't stored, but taken from 
+  a sheet with frames of framew x frameh pixels. Instead of a grid, it holds 
+  a list of lightweight sprites, each with its own position, frame, alpha 
+  and flags. Sprites with higher id are drawn on top of lower ones.
+
+  To find the sprites covering a pixel, framebuffer is divided in bins of 
+  SILBATCH_BIN x SILBATCH_BIN pixels, each with the (sorted) ids of sprites 
+  that overlap it. Pixels are blended front to back, so it stops at the 
+  first sprite that is fully opaque at that pixel.
+
+  Every change of a sprite damages its old and new bounding box only.
+
+ *****************************************************************************/
+
+#define SILBATCH_SHIFT 5
+#define SILBATCH_BIN   (1<<SILBATCH_SHIFT)
+
+/* internal flag of sprite, on top of SILSPRITE_... ones */
+#define SILSPRITE_FREE 128
+
+typedef struct _SILBSPRITE {
+  int x;
+  int y;
+  UINT frame;       /* for free sprites: id of next free one */
+  BYTE alpha;
+  BYTE flags;
+} SILBSPRITE;
+
+typedef struct _SILBIN {
+  UINT *id;
+  UINT cnt;
+  UINT size;
+} SILBIN;
+
+typedef struct _SILBATCH {
+  SILFB *sheet;     /* not owned, belongs to a layer of its own */
+  UINT framew;
+  UINT frameh;
+  UINT perrow;      /* amount of frames in a row of sheet */
+  UINT count;       /* amount of frames in sheet          */
+  SILBSPRITE *sprite;
+  UINT cnt;
+  UINT size;
+  UINT freeid;      /* first free sprite or SILBATCH_NONE */
+  SILBIN *bin;
+  UINT bcols;
+  UINT brows;
+} SILBATCH;
+
+static int binAdd(SILBIN *bin, UINT id) {
+  UINT *new;
+  UINT i;
+
+  if (bin->cnt==bin->size) {
+    new=realloc(bin->id,(bin->size?bin->size*2:8)*sizeof(UINT));
+    if (NULL==new) {
+      log_info("ERR: Can't allocate memory for bin of batch");
+      return 0;
+    }
+    bin->id=new;
+    bin->size=bin->size?bin->size*2:8;
+  }
+  /* keep ids sorted, mostly added at the end */
+  for (i=bin->cnt;(i>0)&&(bin->id[i-1]>id);i--) bin->id[i]=bin->id[i-1];
+  bin->id[i]=id;
+  bin->cnt++;
+  return 1;
+}
+
+static void binDel(SILBIN *bin, UINT id) {
+  UINT lo=0;
+  UINT hi=bin->cnt;
+  UINT mid;
+
+  while (lo<hi) {
+    mid=(lo+hi)/2;
+    if (bin->id[mid]<id) lo=mid+1; else hi=mid;
+  }
+  if ((lo<bin->cnt)&&(bin->id[lo]==id)) {
+    memmove(bin->id+lo,bin->id+lo+1,(bin->cnt-lo-1)*sizeof(UINT));
+    bin->cnt--;
+  }
+}
+
+/* get part of framebuffer covered by sprite, returns 0 if nothing */
+static int spriteBox(SILFB *fb, SILBSPRITE *spr, UINT *minx, UINT *miny, UINT *maxx, UINT *maxy) {
+  SILBATCH *batch=fb->batch;
+  int x2=spr->x+(int)batch->framew;
+  int y2=spr->y+(int)batch->frameh;
+
+  if ((spr->flags&(SILSPRITE_HIDDEN|SILSPRITE_FREE))||(0==spr->alpha)) return 0;
+  if ((x2<=0)||(y2<=0)||(spr->x>=(int)fb->width)||(spr->y>=(int)fb->height)) return 0;
+  *minx=(spr->x<0)?0:spr->x;
+  *miny=(spr->y<0)?0:spr->y;
+  *maxx=SIL_MIN((UINT)x2,fb->width)-1;
+  *maxy=SIL_MIN((UINT)y2,fb->height)-1;
+  return 1;
+}
+
+/* add (add=1) or remove (add=0) sprite to/from all bins it overlaps and damage that area */
+/* returns 0 if sprite couldn't be added to all bins, it is then in none of them        */
+static int binSprite(SILFB *fb, UINT id, BYTE add) {
+  SILBATCH *batch=fb->batch;
+  UINT minx,miny,maxx,maxy;
+
+  if (!spriteBox(fb,&batch->sprite[id],&minx,&miny,&maxx,&maxy)) return 1;
+  for (UINT by=miny>>SILBATCH_SHIFT;by<=maxy>>SILBATCH_SHIFT;by++) {
+    for (UINT bx=minx>>SILBATCH_SHIFT;bx<=maxx>>SILBATCH_SHIFT;bx++) {
+      if (!add) {
+        binDel(&batch->bin[by*batch->bcols+bx],id);
+        continue;
+      }
+      if (!binAdd(&batch->bin[by*batch->bcols+bx],id)) {
+        /* undo bins already done, up to (not including) this one */
+        for (UINT uy=miny>>SILBATCH_SHIFT;uy<=by;uy++) {
+          for (UINT ux=minx>>SILBATCH_SHIFT;ux<=maxx>>SILBATCH_SHIFT;ux++) {
+            if ((uy==by)&&(ux==bx)) break;
+            binDel(&batch->bin[uy*batch->bcols+ux],id);
+          }
+        }
+        return 0;
+      }
+    }
+  }
+  sil_damageFB(fb,minx,miny,maxx-minx+1,maxy-miny+1);
+  return 1;
+}
+
+/* get pixel of sprite at x,y of framebuffer, with alpha of sprite applied */
+static inline BYTE spritePixel(SILBATCH *batch, SILBSPRITE *spr, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue) {
+  BYTE alpha;
+
+  sil_getPixelFB(batch->sheet,(spr->frame%batch->perrow)*batch->framew+(x-spr->x),
+      (spr->frame/batch->perrow)*batch->frameh+(y-spr->y),red,green,blue,&alpha);
+  return (alpha*spr->alpha)/255;
+}
+
+static inline int spriteCovers(SILBATCH *batch, SILBSPRITE *spr, UINT x, UINT y) {
+  if (spr->flags&SILSPRITE_HIDDEN) return 0;
+  return (((int)x>=spr->x)&&((int)y>=spr->y)&&((int)x<spr->x+(int)batch->framew)&&((int)y<spr->y+(int)batch->frameh));
+}
+
+static void getPixelBatch(SILFB *fb, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  SILBATCH *batch=fb->batch;
+  SILBIN *bin;
+  SILBSPRITE *spr;
+  BYTE r,g,b,a;
+  UINT rem=255;     /* how much of pixels below still shows through */
+  UINT w;
+  UINT sr=0,sg=0,sb=0;
+
+  *red=0;
+  *green=0;
+  *blue=0;
+  *alpha=0;
+  if ((x>=fb->width)||(y>=fb->height)) return;
+  bin=&batch->bin[(y>>SILBATCH_SHIFT)*batch->bcols+(x>>SILBATCH_SHIFT)];
+  for (UINT i=bin->cnt;(i>0)&&(rem);i--) {
+    spr=&batch->sprite[bin->id[i-1]];
+    if (!spriteCovers(batch,spr,x,y)) continue;
+    a=spritePixel(batch,spr,x,y,&r,&g,&b);
+    if (0==a) continue;
+    w=a*rem/255;
+    sr+=r*w;
+    sg+=g*w;
+    sb+=b*w;
+    rem-=w;
+    if (255==a) break;
+  }
+  if (rem<255) {
+    *alpha=255-rem;
+    *red=sr/(255-rem);
+    *green=sg/(255-rem);
+    *blue=sb/(255-rem);
+  }
+}
+
+static void freeBatch(SILBATCH *batch) {
+  for (UINT i=0;i<batch->bcols*batch->brows;i++) {
+    if (batch->bin[i].id) free(batch->bin[i].id);
+  }
+  free(batch->bin);
+  if (batch->sprite) free(batch->sprite);
+  free(batch);
+}
+
+
+/*****************************************************************************
+  Initialize batch framebuffer
+  In: sheet framebuffer, width & height of a single frame within sheet, 
+      width and height of batch framebuffer. It starts without sprites.
+ *****************************************************************************/
+
+SILFB *sil_initBatchFB(SILFB *sheet, UINT framew, UINT frameh, UINT width, UINT height) {
+  SILFB *fb;
+  SILBATCH *batch;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==sheet)||(0==sheet->size)||(0==framew)||(0==frameh)||(0==width)||(0==height)) {
+    log_warn("can't initialize batch framebuffer; missing sheet or one or more parameters are zero");
+    return NULL;
+  }
+  if ((framew>sheet->width)||(frameh>sheet->height)) {
+    log_warn("can't initialize batch framebuffer; frames are larger then sheet");
+    return NULL;
+  }
+#endif
+
+  fb=calloc(1,sizeof(SILFB));
+  if (NULL==fb) {
+    log_info("ERR: Can't allocate memory for framebuffer struct");
+    return NULL;
+  }
+  batch=calloc(1,sizeof(SILBATCH));
+  if (NULL==batch) {
+    free(fb);
+    log_info("ERR: Can't allocate memory for batch of framebuffer");
+    return NULL;
+  }
+  batch->bcols=(width+SILBATCH_BIN-1)>>SILBATCH_SHIFT;
+  batch->brows=(height+SILBATCH_BIN-1)>>SILBATCH_SHIFT;
+  batch->bin=calloc((uint64_t)batch->bcols*batch->brows,sizeof(SILBIN));
+  if (NULL==batch->bin) {
+    free(batch);
+    free(fb);
+    log_info("ERR: Can't allocate memory for bins of batch");
+    return NULL;
+  }
+  batch->sheet=sheet;
+  batch->framew=framew;
+  batch->frameh=frameh;
+  batch->perrow=sheet->width/framew;
+  batch->count=batch->perrow*(sheet->height/frameh);
+  batch->freeid=SILBATCH_NONE;
+  fb->batch=batch;
+  fb->buf=NULL;
+  fb->width=width;
+  fb->height=height;
+  fb->type=SILTYPE_ARGB;
+  fb->size=(uint64_t)width*height*4;
+  fb->changed=1;
+  fb->resized=0;
+  return fb;
+}
+
+
+/*****************************************************************************
+  Add sprite to batch framebuffer
+  In: batch SILFB framebuffer context, position and frame of sprite
+  Out: id of sprite, or SILBATCH_NONE if failed
+ *****************************************************************************/
+
+UINT sil_addSpriteFB(SILFB *fb, int x, int y, UINT frame) {
+  SILBATCH *batch;
+  SILBSPRITE *new;
+  UINT id;
+
+  if ((NULL==fb)||(NULL==fb->batch)) {
+    log_warn("trying to add sprite to a non-batch FB ");
+    return SILBATCH_NONE;
+  }
+  batch=fb->batch;
+  if (frame>=batch->count) {
+    log_warn("frame %d outside of sheet",frame);
+    return SILBATCH_NONE;
+  }
+  if (SILBATCH_NONE!=batch->freeid) {
+    /* reuse id of a removed sprite */
+    id=batch->freeid;
+    batch->freeid=batch->sprite[id].frame;
+  } else {
+    if (batch->cnt==batch->size) {
+      new=realloc(batch->sprite,(batch->size?batch->size*2:64)*sizeof(SILBSPRITE));
+      if (NULL==new) {
+        log_info("ERR: Can't allocate memory for sprites of batch");
+        return SILBATCH_NONE;
+      }
+      batch->sprite=new;
+      batch->size=batch->size?batch->size*2:64;
+    }
+    id=batch->cnt++;
+  }
+  batch->sprite[id].x=x;
+  batch->sprite[id].y=y;
+  batch->sprite[id].frame=frame;
+  batch->sprite[id].alpha=255;
+  batch->sprite[id].flags=0;
+  if (!binSprite(fb,id,1)) {
+    /* give id back, so it can be used again */
+    batch->sprite[id].flags=SILSPRITE_FREE;
+    batch->sprite[id].frame=batch->freeid;
+    batch->freeid=id;
+    return SILBATCH_NONE;
+  }
+  fb->version++;
+  return id;
+}
+
+
+/*****************************************************************************
+  Change position, frame, alpha and flags of sprite in batch framebuffer, 
+  only damaging the old and new area of it.
+
+  In: batch SILFB framebuffer context, id of sprite, new values
+  Out: SILERR_ALLOK, SILERR_WRONGFORMAT if id or frame are out of range or
+       SILERR_NOMEM if sprite couldn't be placed (it then stays where it was)
+ *****************************************************************************/
+
+UINT sil_setSpriteFB(SILFB *fb, UINT id, int x, int y, UINT frame, BYTE alpha, BYTE flags) {
+  SILBATCH *batch;
+  SILBSPRITE *spr;
+  SILBSPRITE old;
+
+  if ((NULL==fb)||(NULL==fb->batch)) {
+    log_warn("trying to set sprite of a non-batch FB ");
+    return SILERR_NOTINIT;
+  }
+  batch=fb->batch;
+  if ((id>=batch->cnt)||(batch->sprite[id].flags&SILSPRITE_FREE)||(frame>=batch->count)) {
+    log_warn("sprite %d or frame %d outside of batch",id,frame);
+    return SILERR_WRONGFORMAT;
+  }
+  spr=&batch->sprite[id];
+  flags&=~SILSPRITE_FREE;
+  if ((spr->x==x)&&(spr->y==y)&&(spr->frame==frame)&&(spr->alpha==alpha)&&(spr->flags==flags)) return SILERR_ALLOK;
+  binSprite(fb,id,0);
+  old=*spr;
+  spr->x=x;
+  spr->y=y;
+  spr->frame=frame;
+  spr->alpha=alpha;
+  spr->flags=flags;
+  if (!binSprite(fb,id,1)) {
+    /* bins of old place still have room for it */
+    *spr=old;
+    binSprite(fb,id,1);
+    return SILERR_NOMEM;
+  }
+  fb->version++;
+  return SILERR_ALLOK;
+}
+
+
+/*****************************************************************************
+  Get position, frame, alpha and flags of sprite in batch framebuffer
+  In: batch SILFB framebuffer context, id of sprite, pointers to store values 
+      (all can be NULL)
+  Out: SILERR_ALLOK or SILERR_WRONGFORMAT if there is no such sprite
+ *****************************************************************************/
+
+UINT sil_getSpriteFB(SILFB *fb, UINT id, int *x, int *y, UINT *frame, BYTE *alpha, BYTE *flags) {
+  SILBSPRITE *spr;
+
+  if ((NULL==fb)||(NULL==fb->batch)) {
+    log_warn("trying to get sprite of a non-batch FB ");
+    return SILERR_NOTINIT;
+  }
+  if ((id>=fb->batch->cnt)||(fb->batch->sprite[id].flags&SILSPRITE_FREE)) return SILERR_WRONGFORMAT;
+  spr=&fb->batch->sprite[id];
+  if (x) *x=spr->x;
+  if (y) *y=spr->y;
+  if (frame) *frame=spr->frame;
+  if (alpha) *alpha=spr->alpha;
+  if (flags) *flags=spr->flags;
+  return SILERR_ALLOK;
+}
+
+
+/*****************************************************************************
+  Remove sprite from batch framebuffer, its id can be reused by next one added
+  In: batch SILFB framebuffer context, id of sprite
+ *****************************************************************************/
+
+void sil_removeSpriteFB(SILFB *fb, UINT id) {
+  SILBATCH *batch;
+
+  if ((NULL==fb)||(NULL==fb->batch)) {
+    log_warn("trying to remove sprite of a non-batch FB ");
+    return;
+  }
+  batch=fb->batch;
+  if ((id>=batch->cnt)||(batch->sprite[id].flags&SILSPRITE_FREE)) return;
+  binSprite(fb,id,0);
+  batch->sprite[id].flags=SILSPRITE_FREE;
+  batch->sprite[id].frame=batch->freeid;
+  batch->freeid=id;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+  Get highest sprite in batch framebuffer with a non-transparent pixel at 
+  given position, skipping sprites with SILSPRITE_NOHIT.
+
+  In: batch SILFB framebuffer context, x,y within framebuffer
+  Out: id of sprite or SILBATCH_NONE
+ *****************************************************************************/
+
+UINT sil_spriteAtFB(SILFB *fb, UINT x, UINT y) {
+  SILBATCH *batch;
+  SILBIN *bin;
+  SILBSPRITE *spr;
+  BYTE r,g,b;
+
+  if ((NULL==fb)||(NULL==fb->batch)||(x>=fb->width)||(y>=fb->height)) return SILBATCH_NONE;
+  batch=fb->batch;
+  bin=&batch->bin[(y>>SILBATCH_SHIFT)*batch->bcols+(x>>SILBATCH_SHIFT)];
+  for (UINT i=bin->cnt;i>0;i--) {
+    spr=&batch->sprite[bin->id[i-1]];
+    if (spr->flags&SILSPRITE_NOHIT) continue;
+    if (!spriteCovers(batch,spr,x,y)) continue;
+    if (spritePixel(batch,spr,x,y,&r,&g,&b)) return bin->id[i-1];
+  }
+  return SILBATCH_NONE;
+}
+
+
+/*****************************************************************************
+  Remove all sprites from batch framebuffer
+  In: batch SILFB framebuffer context
+ *****************************************************************************/
+
+static void clearBatch(SILFB *fb) {
+  SILBATCH *batch=fb->batch;
+
+  for (UINT i=0;i<batch->bcols*batch->brows;i++) batch->bin[i].cnt=0;
+  batch->cnt=0;
+  batch->freeid=SILBATCH_NONE;
+  fb->changed=1;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+
+  Nine-slice framebuffers
+
+  Pixels of a nine-slice framebuffer are taken from a source framebuffer, 
+  divided in 3x3 parts by the left, top, right and bottom insets. Corners 
+  are used 1:1, the edges and center are stretched (SILSLICE_STRETCH) or 
+  repeated (SILSLICE_TILE) to cover whatever size the framebuffer has. 
+  Changing the size therefore doesn't cost any memory or copying.
+
+ *****************************************************************************/
+
+typedef struct _SILSLICE {
+  SILFB *source;    /* not owned, belongs to a layer of its own */
+  UINT left;
+  UINT top;
+  UINT right;
+  UINT bottom;
+  BYTE mode;
+  UINT srcversion;  /* version of source when slice was last marked changed */
+} SILSLICE;
+
+/* map position on one axis of nine-slice to position within source */
+static inline UINT sliceAxis(UINT pos, UINT size, UINT ssize, UINT low, UINT high, BYTE mode) {
+  UINT smid,dmid;
+
+  /* if size is smaller then both insets, right/bottom part wins */
+  if (pos+high>=size) return ssize-(size-pos);
+  if (pos<low) return pos;
+  smid=ssize-low-high;
+  dmid=size-low-high;
+  if (0==smid) return low;
+  if (SILSLICE_TILE==mode) return low+(pos-low)%smid;
+  return low+(UINT)(((uint64_t)(pos-low)*smid)/dmid);
+}
+
+static void getPixelSlice(SILFB *fb, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  SILSLICE *slice=fb->slice;
+
+  if ((x>=fb->width)||(y>=fb->height)) {
+    *red=0;
+    *green=0;
+    *blue=0;
+    *alpha=0;
+    return;
+  }
+  sil_getPixelFB(slice->source,
+      sliceAxis(x,fb->width,slice->source->width,slice->left,slice->right,slice->mode),
+      sliceAxis(y,fb->height,slice->source->height,slice->top,slice->bottom,slice->mode),
+      red,green,blue,alpha);
+}
+
+
+/*****************************************************************************
+  Initialize nine-slice framebuffer
+  In: source framebuffer, width & height of nine-slice framebuffer, 
+      left, top, right & bottom insets within source and mode 
+      (SILSLICE_STRETCH or SILSLICE_TILE) for edges and center
+ *****************************************************************************/
+
+SILFB *sil_initSliceFB(SILFB *source, UINT width, UINT height, UINT left, UINT top, UINT right, UINT bottom, BYTE mode) {
+  SILFB *fb;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==source)||(0==source->size)||(0==width)||(0==height)) {
+    log_warn("can't initialize nine-slice framebuffer; missing source or width/height are zero");
+    return NULL;
+  }
+  if ((left+right>source->width)||(top+bottom>source->height)) {
+    log_warn("can't initialize nine-slice framebuffer; insets are larger then source");
+    return NULL;
+  }
+#endif
+
+  fb=calloc(1,sizeof(SILFB));
+  if (NULL==fb) {
+    log_info("ERR: Can't allocate memory for framebuffer struct");
+    return NULL;
+  }
+  fb->slice=calloc(1,sizeof(SILSLICE));
+  if (NULL==fb->slice) {
+    free(fb);
+    log_info("ERR: Can't allocate memory for nine-slice of framebuffer");
+    return NULL;
+  }
+  fb->slice->source=source;
+  fb->slice->left=left;
+  fb->slice->top=top;
+  fb->slice->right=right;
+  fb->slice->bottom=bottom;
+  fb->slice->mode=mode;
+  fb->slice->srcversion=source->version;
+  fb->buf=NULL;
+  fb->type=source->type;
+  fb->changed=1;
+  fb->resized=0;
+  sil_sizeSliceFB(fb,width,height);
+  return fb;
+}
+
+
+/*****************************************************************************
+  Change size of nine-slice framebuffer
+  In: nine-slice SILFB framebuffer context, new width and height
+ *****************************************************************************/
+
+void sil_sizeSliceFB(SILFB *fb, UINT width, UINT height) {
+  if ((NULL==fb)||(NULL==fb->slice)||(0==width)||(0==height)) {
+    log_warn("trying to size a non-nine-slice FB or to zero width/height");
+    return;
+  }
+  fb->width=width;
+  fb->height=height;
+  fb->size=(uint64_t)width*height*SIL_MAX(1,sil_bytesFB(fb->type));
+  fb->changed=1;
+  fb->resized=1;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+  Pick up changes of the source of a nine-slice framebuffer. Drawing on the 
+  source doesn't know about slices using it, so whoever needs to know if a 
+  slice has changed (display, hitmask) calls this first; if the source has 
+  changed since last call, the slice is marked as changed as a whole.
+  Does nothing for other types of framebuffers.
+
+  In: SILFB framebuffer context
+ *****************************************************************************/
+
+void sil_syncSliceFB(SILFB *fb) {
+  SILSLICE *slice;
+
+  if ((NULL==fb)||(NULL==fb->slice)) return;
+  slice=fb->slice;
+  if (slice->srcversion==slice->source->version) return;
+  slice->srcversion=slice->source->version;
+  fb->changed=1;
+  fb->version++;
+}
+
+
+/*****************************************************************************
+  Mark part of framebuffer as changed. As long as the framebuffer isn't 
+  marked as changed as a whole, the damaged parts are combined into a single 
+  box, so displays that keep a copy of each framebuffer (SDL) only have to 
+  update that part. Both "changed" and damage are reset after display update.
+
+  In: SILFB framebuffer context, x,y,width & height of changed area
+ *****************************************************************************/
+
+void sil_damageFB(SILFB *fb, UINT x, UINT y, UINT width, UINT height) {
+  UINT maxx,maxy;
+
+  if ((NULL==fb)||(fb->changed)||(0==width)||(0==height)) return;
+  if (0==fb->damage.width) {
+    fb->damage.minx=x;
+    fb->damage.miny=y;
+    fb->damage.width=width;
+    fb->damage.height=height;
+    return;
+  }
+  maxx=SIL_MAX(x+width,fb->damage.minx+fb->damage.width);
+  maxy=SIL_MAX(y+height,fb->damage.miny+fb->damage.height);
+  fb->damage.minx=SIL_MIN(x,fb->damage.minx);
+  fb->damage.miny=SIL_MIN(y,fb->damage.miny);
+  fb->damage.width=maxx-fb->damage.minx;
+  fb->damage.height=maxy-fb->damage.miny;
+}
+
+
 /*****************************************************************************
   Initialize Framebuffer
   In: width & height of framebuffer + RGB format
@@ -31,6 +1128,8 @@
   666 = 6bits + 6bits + 6bits               = 3   bytes per pixel (2 bits unused)
   888 = 8bits + 8bits + 8bits               = 3   bytes per pixel 
   ABGR/ARGB = 8bits + 8bits + 8bits + 8bits = 4   bytes per pixel 
+  4444ARGB  = 4bits + 4bits + 4bits + 4bits = 2   bytes per pixel 
+  1555ARGB  = 1bit  + 5bits + 5bits + 5bits = 2   bytes per pixel (alpha on/off)
 
   SILTYPE_EMPTY is used to just to support empty layers with resizable 
   dimensions, used attach eventhandlers to it.
@@ -40,7 +1139,7 @@
 
 SILFB *sil_initFB(UINT width, UINT height, BYTE type) {
   SILFB *fb;
-  UINT size=0;
+  uint64_t size=0;
 
 #ifndef SIL_LIVEDANGEROUS
 
@@ -54,27 +1153,31 @@ SILFB *sil_initFB(UINT width, UINT height, BYTE type) {
   switch(type) {
     case SILTYPE_332RGB:
     case SILTYPE_332BGR:
-      size=width*height;
+      size=(uint64_t)width*height;
       break;
     case SILTYPE_444RGB:
     case SILTYPE_444BGR:
-      size=1+width*height*1.5;
+      size=1+(uint64_t)width*height*3/2;
       break;
     case SILTYPE_555RGB:
     case SILTYPE_565RGB:
     case SILTYPE_555BGR:
     case SILTYPE_565BGR:
-      size=width*height*2;
+      size=(uint64_t)width*height*2;
       break;
     case SILTYPE_666RGB:
     case SILTYPE_666BGR:
     case SILTYPE_888RGB:
     case SILTYPE_888BGR:
-      size=width*height*3;
+      size=(uint64_t)width*height*3;
       break;
     case SILTYPE_ABGR:
     case SILTYPE_ARGB:
-      size=width*height*4;
+      size=(uint64_t)width*height*4;
+      break;
+    case SILTYPE_4444ARGB:
+    case SILTYPE_1555ARGB:
+      size=(uint64_t)width*height*2;
       break;
 
     case SILTYPE_EMPTY:
@@ -133,6 +1236,15 @@ void sil_putPixelFB(SILFB *fb,UINT x,UINT y,BYTE red, BYTE green, BYTE blue, BYT
     log_warn("trying to putpixel on non-initialized FB ");
     return;
   }
+#endif
+  if (fb->tiles) {
+    putPixelTiles(fb,x,y,red,green,blue,alpha);
+    return;
+  }
+  /* pixels of tilemap, batch and nine-slice are taken from other fb, */
+  /* nothing to write to                                              */
+  if ((fb->map)||(fb->batch)||(fb->slice)) return;
+#ifndef SIL_LIVEDANGEROUS
   if (NULL==fb->buf) {
     log_warn("trying to a non-allocated FB buffer ");
     return;
@@ -230,8 +1342,17 @@ void sil_putPixelFB(SILFB *fb,UINT x,UINT y,BYTE red, BYTE green, BYTE blue, BYT
       buf[x*4+2+y*width*4]=red;
       buf[x*4+3+y*width*4]=alpha;
       break;
+    case SILTYPE_4444ARGB:
+      buf[x*2+  width*y*2]=(green&0xF0)|(blue>>4);
+      buf[x*2+1+width*y*2]=(alpha&0xF0)|(red >>4);
+      break;
+    case SILTYPE_1555ARGB:
+      buf[x*2+  width*y*2]=((green&0x38)<<2)|(blue>>3);
+      buf[x*2+1+width*y*2]=(alpha&0x80)|((red&0xF8)>>1)|(green>>6);
+      break;
   }
   fb->changed=1;
+  fb->version++;
 }
 
 /*****************************************************************************
@@ -259,6 +1380,24 @@ void sil_getPixelFB(SILFB *fb,UINT x,UINT y, BYTE *red, BYTE *green, BYTE *blue,
     log_warn("trying to getpixel an non-initialized FB ");
     return;
   }
+#endif
+  if (fb->tiles) {
+    getPixelTiles(fb,x,y,red,green,blue,alpha);
+    return;
+  }
+  if (fb->map) {
+    getPixelMap(fb,x,y,red,green,blue,alpha);
+    return;
+  }
+  if (fb->batch) {
+    getPixelBatch(fb,x,y,red,green,blue,alpha);
+    return;
+  }
+  if (fb->slice) {
+    getPixelSlice(fb,x,y,red,green,blue,alpha);
+    return;
+  }
+#ifndef SIL_LIVEDANGEROUS
   if ((0==fb->size)||(NULL==fb->buf)) {
     log_warn("trying to getpixel an zero size or non-allocated FB buffer ");
     return;
@@ -378,6 +1517,78 @@ void sil_getPixelFB(SILFB *fb,UINT x,UINT y, BYTE *red, BYTE *green, BYTE *blue,
       *red  =buf[x*4+2+width*y*4];
       *alpha=buf[x*4+3+width*y*4];
       break;
+    case SILTYPE_4444ARGB: 
+      /* repeat bits, so 0xF becomes 0xFF and alpha can be fully opaque */
+      val2=buf[x*2+  width*y*2];
+      val1=buf[x*2+1+width*y*2];
+      *alpha=(val1&0xF0)|(val1>>4);
+      *red  =(val1<<4)  |(val1&0x0F);
+      *green=(val2&0xF0)|(val2>>4);
+      *blue =(val2<<4)  |(val2&0x0F);
+      break;
+    case SILTYPE_1555ARGB: 
+      val2=buf[x*2+  width*y*2];
+      val1=buf[x*2+1+width*y*2];
+      *alpha=(val1&0x80)?255:0;
+      *red  =((val1&0x7C)<<1)|((val1&0x70)>>4);
+      *green=((val1&0x03)<<6)|((val2&0xE0)>>2);
+      *green|=*green>>5;
+      *blue =(val2<<3)|((val2&0x1C)>>2);
+      break;
+  }
+}
+
+/*****************************************************************************
+
+  Fill part of a row of framebuffer with the same pixel. First pixel is 
+  written as usual, all others are copies of its bytes, doubling the amount
+  copied every step. All types with whole bytes per pixel use this, including
+  the 16 bits SILTYPE_4444ARGB and SILTYPE_1555ARGB. Only SILTYPE_444RGB and 
+  SILTYPE_444BGR (two pixels share three bytes) and framebuffers without a 
+  buffer of their own are done pixel by pixel. Tiled framebuffers are filled
+  per tile, tiles that don't exist yet are skipped when filled with empty 
+  pixels.
+
+  In: SILFB framebuffer context, x,y of first pixel, amount of pixels, 
+      BYTE red/green/blue/alpha values
+
+ *****************************************************************************/
+
+void sil_fillRowFB(SILFB *fb, UINT x, UINT y, UINT len, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  BYTE *start;
+  BYTE bpp;
+  SILFB *tile;
+  UINT part;
+  BYTE empty;
+  uint64_t done,total;
+
+  if ((NULL==fb)||(x>=fb->width)||(y>=fb->height)||(0==len)) return;
+  if (len>fb->width-x) len=fb->width-x;
+  if (fb->tiles) {
+    empty=(0==red)&&(0==green)&&(0==blue)&&(0==alpha);
+    while (len) {
+      part=SIL_MIN(len,SILTILE_SIZE-(x&(SILTILE_SIZE-1)));
+      tile=getTile(fb,x>>SILTILE_SHIFT,y>>SILTILE_SHIFT,!empty);
+      if (tile) sil_fillRowFB(tile,x&(SILTILE_SIZE-1),y&(SILTILE_SIZE-1),part,red,green,blue,alpha);
+      x+=part;
+      len-=part;
+    }
+    fb->changed=1;
+    fb->version++;
+    return;
+  }
+  bpp=sil_bytesFB(fb->type);
+  if ((NULL==fb->buf)||(0==bpp)) {
+    for (UINT i=0;i<len;i++) sil_putPixelFB(fb,x+i,y,red,green,blue,alpha);
+    return;
+  }
+  sil_putPixelFB(fb,x,y,red,green,blue,alpha);
+  start=fb->buf+((uint64_t)y*fb->width+x)*bpp;
+  done=bpp;
+  total=(uint64_t)len*bpp;
+  while (done<total) {
+    memcpy(start+done,start,SIL_MIN(done,total-done));
+    done+=SIL_MIN(done,total-done);
   }
 }
 
@@ -392,8 +1603,23 @@ void sil_getPixelFB(SILFB *fb,UINT x,UINT y, BYTE *red, BYTE *green, BYTE *blue,
 
 void sil_clearFB(SILFB *fb) {
   /* size is used to check for initialization of variables inside FB context */
-  if ((fb)&&(fb->size)) {
+  if ((fb)&&(fb->tiles)) {
+    /* just throw away all tiles */
+    freeTiles(fb->tiles);
+    fb->changed=1;
+    fb->version++;
+  } else if ((fb)&&(fb->map)) {
+    /* empty all cells, tileset itself isn't touched */
+    sil_fillCellsFB(fb,SILMAP_NONE);
+  } else if ((fb)&&(fb->batch)) {
+    /* remove all sprites, sheet itself isn't touched */
+    clearBatch(fb);
+  } else if ((fb)&&(fb->slice)) {
+    log_warn("nine-slice framebuffer has no pixels of its own to clear");
+  } else if ((fb)&&(fb->size)) {
     memset(fb->buf,0,fb->size);
+    fb->changed=1;
+    fb->version++;
   } else {
     log_warn("trying to clear a non-initialized FB ");
   }
@@ -410,7 +1636,19 @@ void sil_clearFB(SILFB *fb) {
 
 void sil_destroyFB(SILFB *fb) {
   if (fb) {
-    if (fb->size && fb->buf) {
+    sil_clearMaskFB(fb);
+    if (fb->tiles) {
+      freeTiles(fb->tiles);
+      free(fb->tiles->slot);
+      free(fb->tiles);
+    } else if (fb->map) {
+      free(fb->map->cell);
+      free(fb->map);
+    } else if (fb->batch) {
+      freeBatch(fb->batch);
+    } else if (fb->slice) {
+      free(fb->slice);
+    } else if (fb->size && fb->buf) {
       free(fb->buf);
     } else {
       log_warn("trying to destroy an empty FB buffer ");
@@ -421,3 +1659,274 @@ void sil_destroyFB(SILFB *fb) {
     log_warn("trying to destroy a non-initialized FB ");
   }
 }
+
+
+/*****************************************************************************
+  
+  Hitmasks
+
+  A hitmask is a 1 bit per pixel copy of the framebuffer, telling if a pixel
+  should be considered "solid" for mouse events. It is build (lazily) on the
+  first hittest after pixels have changed, by comparing the version of the 
+  framebuffer with the one the mask has been build from. Because mask is part 
+  of the framebuffer, all instances of a layer share the same mask.
+
+  Two modes:
+  SILMASK_ALPHA - pixel is solid if alpha value is above threshold
+  SILMASK_KEY   - pixel is solid if color isn't the given color key. Key is 
+                  converted to colordepth of framebuffer first, so it can be 
+                  compared with the values read back from it.
+
+ *****************************************************************************/
+
+typedef struct _SILMASK {
+  BYTE *bits;
+  UINT width;
+  UINT height;
+  UINT stride;      /* bytes per row                                     */
+  UINT version;     /* version of framebuffer the mask is build from     */
+  BYTE valid;
+  BYTE mode;
+  BYTE threshold;
+  BYTE red;
+  BYTE green;
+  BYTE blue;
+} SILMASK;
+
+
+/*****************************************************************************
+  Convert color to the colordepth of given framebuffer type, by writing and 
+  reading back a single pixel.
+
+  In: framebuffer type, pointers to red/green/blue values 
+ *****************************************************************************/
+
+void sil_quantizeFB(BYTE type, BYTE *red, BYTE *green, BYTE *blue) {
+  SILFB tmp;
+  BYTE buf[4]={0,0,0,0};
+  BYTE alpha=0;
+
+  memset(&tmp,0,sizeof(SILFB));
+  tmp.buf=buf;
+  tmp.width=1;
+  tmp.height=1;
+  tmp.size=sizeof(buf);
+  tmp.type=type;
+  sil_putPixelFB(&tmp,0,0,*red,*green,*blue,255);
+  sil_getPixelFB(&tmp,0,0,red,green,blue,&alpha);
+}
+
+
+/*****************************************************************************
+  Set (or change) hitmask of framebuffer, mask itself is build when needed
+
+  In: SILFB Framebuffer context, mode (SILMASK_ALPHA or SILMASK_KEY),
+      threshold (alpha mode) and red, green & blue (key mode)
+ *****************************************************************************/
+
+void sil_setMaskFB(SILFB *fb, BYTE mode, BYTE threshold, BYTE red, BYTE green, BYTE blue) {
+  SILMASK *mask;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==fb)||(0==fb->size)) {
+    log_warn("trying to set hitmask on a non-initialized FB ");
+    return;
+  }
+#endif
+  if (fb->tiles) {
+    log_warn("hitmasks aren't supported for tiled framebuffers");
+    return;
+  }
+
+  if (NULL==fb->mask) {
+    fb->mask=calloc(1,sizeof(SILMASK));
+    if (NULL==fb->mask) {
+      log_info("ERR: Can't allocate memory for hitmask");
+      return;
+    }
+  }
+  mask=fb->mask;
+  if (SILMASK_KEY==mode) sil_quantizeFB(fb->type,&red,&green,&blue);
+  mask->mode=mode;
+  mask->threshold=threshold;
+  mask->red=red;
+  mask->green=green;
+  mask->blue=blue;
+  mask->valid=0;
+}
+
+
+/*****************************************************************************
+  Remove hitmask from framebuffer
+ *****************************************************************************/
+
+void sil_clearMaskFB(SILFB *fb) {
+  if ((fb)&&(fb->mask)) {
+    if (fb->mask->bits) free(fb->mask->bits);
+    free(fb->mask);
+    fb->mask=NULL;
+  }
+}
+
+
+/*****************************************************************************
+  (Re)build bits of hitmask from framebuffer, returns 0 if failed
+ *****************************************************************************/
+
+static int buildMask(SILFB *fb) {
+  SILMASK *mask=fb->mask;
+  BYTE red,green,blue,alpha;
+  BYTE *row;
+  BYTE *src;
+  UINT x,y;
+
+  if ((NULL==mask->bits)||(mask->width!=fb->width)||(mask->height!=fb->height)) {
+    if (mask->bits) free(mask->bits);
+    mask->width=fb->width;
+    mask->height=fb->height;
+    mask->stride=(fb->width+7)/8;
+    mask->bits=malloc(mask->stride*fb->height);
+    if (NULL==mask->bits) {
+      log_info("ERR: Can't allocate memory for bits of hitmask");
+      return 0;
+    }
+  }
+  memset(mask->bits,0,mask->stride*fb->height);
+
+  for (y=0;y<fb->height;y++) {
+    row=mask->bits+y*mask->stride;
+    if ((SILMASK_ALPHA==mask->mode)&&(fb->buf)&&(!fb->colorkey)&&((SILTYPE_ARGB==fb->type)||(SILTYPE_ABGR==fb->type))) {
+      /* alpha is in same place for both 32 bits types, no need to decode */
+      src=fb->buf+y*fb->width*4+3;
+      for (x=0;x<fb->width;x++) {
+        if (src[x*4]>mask->threshold) row[x>>3]|=0x80>>(x&7);
+      }
+      continue;
+    }
+    for (x=0;x<fb->width;x++) {
+      sil_getPixelFB(fb,x,y,&red,&green,&blue,&alpha);
+      if ((fb->colorkey)&&(red==fb->keyred)&&(green==fb->keygreen)&&(blue==fb->keyblue)) continue;
+      if (SILMASK_KEY==mask->mode) {
+        if ((red!=mask->red)||(green!=mask->green)||(blue!=mask->blue)) row[x>>3]|=0x80>>(x&7);
+      } else {
+        if (alpha>mask->threshold) row[x>>3]|=0x80>>(x&7);
+      }
+    }
+  }
+  mask->version=fb->version;
+  mask->valid=1;
+  return 1;
+}
+
+
+/*****************************************************************************
+  Test a single pixel against the hitmask of framebuffer, (re)building it 
+  first if pixels have been changed since last time.
+
+  In: SILFB Framebuffer context, x,y position within framebuffer
+  Out: 1 if pixel is solid, 0 if not or outside framebuffer
+ *****************************************************************************/
+
+BYTE sil_hitMaskFB(SILFB *fb, UINT x, UINT y) {
+  SILMASK *mask=fb->mask;
+
+  if ((x>=fb->width)||(y>=fb->height)) return 0;
+  sil_syncSliceFB(fb);
+  if ((!mask->valid)||(mask->version!=fb->version)) {
+    if (!buildMask(fb)) return 0;
+  }
+  return (mask->bits[y*mask->stride+(x>>3)]&(0x80>>(x&7)))?1:0;
+}
+
+
+/*****************************************************************************
+  Returns amount of bytes per pixel for given framebuffer type, or 0 if 
+  pixels don't fit in whole bytes (444 types) or for SILTYPE_EMPTY
+ *****************************************************************************/
+
+BYTE sil_bytesFB(BYTE type) {
+  switch(type) {
+    case SILTYPE_332RGB:
+    case SILTYPE_332BGR:
+      return 1;
+    case SILTYPE_555RGB:
+    case SILTYPE_565RGB:
+    case SILTYPE_555BGR:
+    case SILTYPE_565BGR:
+      return 2;
+    case SILTYPE_666RGB:
+    case SILTYPE_666BGR:
+    case SILTYPE_888RGB:
+    case SILTYPE_888BGR:
+      return 3;
+    case SILTYPE_ABGR:
+    case SILTYPE_ARGB:
+      return 4;
+    case SILTYPE_4444ARGB:
+    case SILTYPE_1555ARGB:
+      return 2;
+  }
+  return 0;
+}
+
+
+/*****************************************************************************
+  
+  Framebuffer of a scrolling layer is used as ringbuffer, pixel 0,0 of the 
+  layer is at originx,originy within the framebuffer (see sil_scrollLayer). 
+  Functions that use the buffer directly, instead of via the layer, call this
+  first to move the pixels back in place and reset the origin to 0,0.
+
+  In: SILFB Framebuffer context
+
+ *****************************************************************************/
+
+void sil_unwrapFB(SILFB *fb) {
+  BYTE *buf;
+  BYTE *src;
+  BYTE *dst;
+  BYTE bpp;
+  BYTE red,green,blue,alpha;
+  UINT ox,oy;
+  SILFB tmp;
+
+  if ((NULL==fb)||((0==fb->originx)&&(0==fb->originy))) return;
+  if (NULL==fb->buf) {
+    /* tiled: would need whole virtual size, tilemap: nothing to move */
+    log_warn("can't unwrap framebuffer without a buffer of its own");
+    return;
+  }
+  buf=calloc(1,fb->size);
+  if (NULL==buf) {
+    log_info("ERR: Can't allocate memory for unwrapping framebuffer");
+    return;
+  }
+  ox=fb->originx;
+  oy=fb->originy;
+  bpp=sil_bytesFB(fb->type);
+  if (bpp) {
+    /* every row is rotated as two parts */
+    for (UINT y=0;y<fb->height;y++) {
+      src=fb->buf+((y+oy)%fb->height)*fb->width*bpp;
+      dst=buf+y*fb->width*bpp;
+      memcpy(dst,src+ox*bpp,(fb->width-ox)*bpp);
+      memcpy(dst+(fb->width-ox)*bpp,src,ox*bpp);
+    }
+  } else {
+    memcpy(&tmp,fb,sizeof(SILFB));
+    tmp.buf=buf;
+    tmp.mask=NULL;
+    for (UINT y=0;y<fb->height;y++) {
+      for (UINT x=0;x<fb->width;x++) {
+        sil_getPixelFB(fb,(x+ox)%fb->width,(y+oy)%fb->height,&red,&green,&blue,&alpha);
+        sil_putPixelFB(&tmp,x,y,red,green,blue,alpha);
+      }
+    }
+  }
+  free(fb->buf);
+  fb->buf=buf;
+  fb->originx=0;
+  fb->originy=0;
+  fb->changed=1;
+  fb->version++;
+}
@@ -75,14 +75,443 @@ About: Using Layers
 #include "sil_int.h"
 #include "log.h"
 
+/* spatial index of layers with mouse handlers, see sil_updateIndex */
+#define SILGRID_CELL       64  /* width & height of a single cell in pixels                 */
+#define SILGRID_BUCKETS   256  /* amount of hash buckets for cells, must be power of 2       */
+#define SILGRID_MAXCELLS 1024  /* layers covering more cells are kept in a seperate list     */
+
+/* index of key handlers, see keyIndex */
+#define SILKEY_BUCKETS     64  /* amount of hash buckets for key/modifier combinations      */
+
+/* layers are allocated in slabs, see poolAlloc */
+#define SILPOOL_SLAB       64  /* amount of layers per slab                                 */
+
+typedef struct _GLIST {
+  SILLYR **item;
+  UINT cnt;
+  UINT size;
+} GLIST;
+
+typedef struct _GCACHE {
+  UINT generation;    /* generation of index when candidates were collected */
+  int cellx;          /* cell the candidates are collected for              */
+  int celly;
+  GLIST cand;         /* candidates, highest layer first                    */
+} GCACHE;
+
+typedef struct _GSLAB {
+  SILLYR layer[SILPOOL_SLAB];
+  struct _GSLAB *next;
+} GSLAB;
+
 typedef struct _GLYR {
   /* head & tail of linked list of layers */
   SILLYR *top;
   SILLYR *bottom;
-  UINT idcount;  /* unique identifiers for layers (not used at the moment) */
+  /* same layers, bottom to top, as dense array (valid if zdirty isn't set) */
+  SILLYR **zorder;
+  UINT zcnt;
+  UINT zsize;
+  /* pool of layers */
+  GSLAB *slabs;
+  SILLYR *unused;   /* free layers within slabs, linked via next */
+  UINT idcount;  /* unique identifiers for layers, see sil_getLayerById    */
+  /* hashtable of layers by id, open addressing with linear probing */
+  SILLYR **ids;
+  UINT idsize;   /* always power of 2 */
+  UINT idused;
+  /* spatial index, used for finding layers under mousepointer */
+  GLIST grid[SILGRID_BUCKETS];
+  GLIST large;      /* layers that are too large to put in cells  */
+  GLIST shields;    /* visible layers with SILFLAG_MOUSESHIELD    */
+  UINT generation;  /* changes every time index or stack changes  */
+  BYTE zdirty;      /* stacking order changed, zpos must be redone */
+  GCACHE click;
+  GCACHE hover;
+  /* index of key handlers */
+  GLIST keys[SILKEY_BUCKETS];
+  GLIST catchall;   /* key handlers without key and modifiers     */
+  /* groups with layers that must be reindexed */
+  SILGROUP **stale;
+  UINT stalecnt;
+  UINT stalesize;
 } GLYR;
 
-static GLYR gv={NULL,NULL,0}; /* holds all global variables used only within layers.c */
+static GLYR gv={0}; /* holds all global variables used only within layers.c */
+
+static void screenBox(SILLYR *, int *, int *, UINT *, UINT *);
+static void unlinkLayer(SILLYR *);
+
+
+/*****************************************************************************
+
+  Internal functions for spatial index.
+  
+  Instead of walking all layers from top to bottom for every mouse movement, 
+  visible layers with click, drag or hover handlers are kept in a uniform grid 
+  of cells of SILGRID_CELL pixels. Cells are hashed into a fixed amount of 
+  buckets, so grid doesn't depend on size of display. Layers are re-indexed 
+  every time their position, size, visibility or handlers change via SIL 
+  functions (so don't change relx,rely,view or flags directly !).
+
+  Stacking order is kept as 'zpos' in every layer, but only renumbered when 
+  needed after the stack has been changed.
+
+ *****************************************************************************/
+
+static void listAdd(GLIST *list, SILLYR *layer) {
+  SILLYR **tmp;
+
+  for (UINT i=0;i<list->cnt;i++) {
+    if (list->item[i]==layer) return;
+  }
+  if (list->cnt>=list->size) {
+    tmp=realloc(list->item,(list->size?list->size*2:8)*sizeof(SILLYR *));
+    if (NULL==tmp) {
+      log_warn("Can't allocate memory for index of layers");
+      return;
+    }
+    list->item=tmp;
+    list->size=list->size?list->size*2:8;
+  }
+  list->item[list->cnt++]=layer;
+}
+
+static void listDel(GLIST *list, SILLYR *layer) {
+  for (UINT i=0;i<list->cnt;i++) {
+    if (list->item[i]==layer) {
+      list->item[i]=list->item[--list->cnt];
+      return;
+    }
+  }
+}
+
+static inline GLIST *bucket(int cellx, int celly) {
+  return &gv.grid[((UINT)cellx*73856093u ^ (UINT)celly*19349663u)&(SILGRID_BUCKETS-1)];
+}
+
+/* cell of position, rounding to negative infinity */
+static inline int cellOf(int pos) {
+  if (pos<0) return -((SILGRID_CELL-1-pos)/SILGRID_CELL);
+  return pos/SILGRID_CELL;
+}
+
+static void unindex(SILLYR *layer) {
+  if (layer->internal&SILFLAG_INDEXED) {
+    if (((layer->idx.maxx-layer->idx.minx+1)*(layer->idx.maxy-layer->idx.miny+1))>SILGRID_MAXCELLS) {
+      listDel(&gv.large,layer);
+    } else {
+      for (int cy=layer->idx.miny;cy<=layer->idx.maxy;cy++) {
+        for (int cx=layer->idx.minx;cx<=layer->idx.maxx;cx++) {
+          listDel(bucket(cx,cy),layer);
+        }
+      }
+    }
+    layer->internal&=~SILFLAG_INDEXED;
+  }
+  if (layer->internal&SILFLAG_SHIELDED) {
+    listDel(&gv.shields,layer);
+    layer->internal&=~SILFLAG_SHIELDED;
+  }
+}
+
+/* internal function, must be called after anything changes position, size, visibility or 
+   mouse handlers of layer */
+void sil_updateIndex(SILLYR *layer) {
+  int x,y;
+  UINT w,h;
+
+  unindex(layer);
+  gv.generation++;
+  if ((!layer->init)||(!sil_resolveLayer(layer,NULL,NULL,NULL))) return;
+
+  if (layer->flags&SILFLAG_MOUSESHIELD) {
+    listAdd(&gv.shields,layer);
+    layer->internal|=SILFLAG_SHIELDED;
+  }
+  if ((NULL==layer->click)&&(NULL==layer->hover)&&(!(layer->flags&SILFLAG_DRAGGABLE))) return;
+
+  screenBox(layer,&x,&y,&w,&h);
+  if ((0==w)||(0==h)) return;
+  layer->idx.minx=cellOf(x);
+  layer->idx.miny=cellOf(y);
+  layer->idx.maxx=cellOf(x+(int)w-1);
+  layer->idx.maxy=cellOf(y+(int)h-1);
+  if (((layer->idx.maxx-layer->idx.minx+1)*(layer->idx.maxy-layer->idx.miny+1))>SILGRID_MAXCELLS) {
+    listAdd(&gv.large,layer);
+  } else {
+    for (int cy=layer->idx.miny;cy<=layer->idx.maxy;cy++) {
+      for (int cx=layer->idx.minx;cx<=layer->idx.maxx;cx++) {
+        listAdd(bucket(cx,cy),layer);
+      }
+    }
+  }
+  layer->internal|=SILFLAG_INDEXED;
+}
+
+/*****************************************************************************
+
+  Internal functions for groups.
+
+  Position of a layer in a group is relative to that group, and groups can 
+  be part of other groups again. Offset, alpha and visibility of all groups 
+  above a layer are combined when drawing or searching it, so moving or 
+  hiding a group only changes the group itself.
+
+  Layers within moved, shown or hidden groups aren't reindexed right away, 
+  group is marked "stale" instead and done with the first search for a layer
+  under the mousepointer afterwards.
+
+ *****************************************************************************/
+
+/* position of layer on display */
+static inline void origin(SILLYR *layer, int *x, int *y) {
+  SILGROUP *group;
+
+  *x=layer->relx;
+  *y=layer->rely;
+  for (group=layer->group;group;group=group->parent) {
+    *x+=group->relx;
+    *y+=group->rely;
+  }
+}
+
+/* internal function, position within framebuffer of pixel x,y of layer, */
+/* when framebuffer is used as ringbuffer (see sil_scrollLayer)          */
+static inline void ringPos(SILFB *fb, UINT *x, UINT *y) {
+  *x+=fb->originx;
+  if (*x>=fb->width) *x-=fb->width;
+  *y+=fb->originy;
+  if (*y>=fb->height) *y-=fb->height;
+}
+
+/* internal function, get position on display and alpha of layer including  */
+/* groups it is in, returns 0 if layer or one of those groups is invisible   */
+BYTE sil_resolveLayer(SILLYR *layer, int *x, int *y, float *alpha) {
+  SILGROUP *group;
+  int rx,ry;
+  float ra;
+  BYTE visible;
+
+  rx=layer->relx;
+  ry=layer->rely;
+  ra=layer->alpha;
+  visible=!(layer->flags&SILFLAG_INVISIBLE);
+  for (group=layer->group;group;group=group->parent) {
+    rx+=group->relx;
+    ry+=group->rely;
+    ra*=group->alpha;
+    if (group->flags&SILFLAG_INVISIBLE) visible=0;
+  }
+  if (x) *x=rx;
+  if (y) *y=ry;
+  if (alpha) *alpha=ra;
+  return visible;
+}
+
+static void markStale(SILGROUP *group) {
+  SILGROUP **tmp;
+
+  gv.generation++;
+  if (group->stale) return;
+  if (gv.stalecnt>=gv.stalesize) {
+    tmp=realloc(gv.stale,(gv.stalesize?gv.stalesize*2:8)*sizeof(SILGROUP *));
+    if (NULL==tmp) {
+      log_warn("Can't allocate memory for list of changed groups");
+      return;
+    }
+    gv.stale=tmp;
+    gv.stalesize=gv.stalesize?gv.stalesize*2:8;
+  }
+  gv.stale[gv.stalecnt++]=group;
+  group->stale=1;
+}
+
+static void reindexGroup(SILGROUP *group) {
+  SILLYR *layer;
+  SILGROUP *sub;
+
+  group->stale=0;
+  for (layer=group->layers;layer;layer=layer->gnext) sil_updateIndex(layer);
+  for (sub=group->first;sub;sub=sub->next) reindexGroup(sub);
+}
+
+static void refreshGroups() {
+  for (UINT i=0;i<gv.stalecnt;i++) {
+    /* might already be done via one of its parents */
+    if (gv.stale[i]->stale) reindexGroup(gv.stale[i]);
+  }
+  gv.stalecnt=0;
+}
+
+/* internal function, renumber zpos of all layers, bottom is 0, and rebuild  */
+/* the dense array of layers in stacking order. If that array can't grow, it */
+/* is left empty and zdirty stays set, callers then walk the linked list     */
+static void renumber() {
+  UINT zpos=0;
+  SILLYR *layer=gv.bottom;
+  SILLYR **tmp;
+
+  while (layer) {
+    if (zpos>=gv.zsize) {
+      tmp=realloc(gv.zorder,(gv.zsize?gv.zsize*2:64)*sizeof(SILLYR *));
+      if (NULL==tmp) {
+        log_warn("Can't allocate memory for stacking order of layers");
+        gv.zcnt=0;
+        return;
+      }
+      gv.zorder=tmp;
+      gv.zsize=gv.zsize?gv.zsize*2:64;
+    }
+    gv.zorder[zpos]=layer;
+    layer->idx.zpos=zpos++;
+    layer=layer->next;
+  }
+  gv.zcnt=zpos;
+  gv.zdirty=0;
+  gv.generation++;
+}
+
+
+/*****************************************************************************
+
+  Internal function for index of key handlers
+
+  Layers with a key handler are kept in a bucket depending on key and 
+  modifiers they are waiting for, or in a seperate list if they catch all
+  keys. Stacking order is handled via zpos, so index doesn't change when
+  layers are moved up or down the stack.
+
+  Must be called to remove layer before changing handler, key or modifiers 
+  and to add it again afterwards.
+
+ *****************************************************************************/
+
+static inline GLIST *keyBucket(UINT key, BYTE modifiers) {
+  return &gv.keys[(key*31u+modifiers)&(SILKEY_BUCKETS-1)];
+}
+
+static void keyIndex(SILLYR *layer, BYTE add) {
+  GLIST *list;
+
+  if (NULL==layer->keypress) return;
+  if ((layer->key)||(layer->modifiers)) {
+    list=keyBucket(layer->key,layer->modifiers);
+  } else {
+    list=&gv.catchall;
+  }
+  if (add) {
+    listAdd(list,layer);
+  } else {
+    listDel(list,layer);
+  }
+}
+
+
+/*****************************************************************************
+
+  Internal functions for table of layers by id.
+  
+  Ids are never reused, so table is a hashtable instead of an array indexed 
+  by id, keeping it small when lots of layers are created and destroyed. It
+  is kept at most half full, and entries are shifted back on removal so no 
+  "deleted" markers are needed.
+
+ *****************************************************************************/
+
+static inline UINT idSlot(UINT id) {
+  return (id*2654435761u)&(gv.idsize-1);
+}
+
+static int idAdd(SILLYR *layer) {
+  SILLYR **old=gv.ids;
+  UINT oldsize=gv.idsize;
+  UINT i;
+
+  if ((gv.idused+1)*2>gv.idsize) {
+    gv.idsize=gv.idsize?gv.idsize*2:64;
+    gv.ids=calloc(gv.idsize,sizeof(SILLYR *));
+    if (NULL==gv.ids) {
+      log_warn("Can't allocate memory for table of layer ids");
+      gv.ids=old;
+      gv.idsize=oldsize;
+      return 0;
+    }
+    gv.idused=0;
+    for (i=0;i<oldsize;i++) {
+      if (old[i]) idAdd(old[i]);
+    }
+    if (old) free(old);
+  }
+  i=idSlot(layer->id);
+  while (gv.ids[i]) i=(i+1)&(gv.idsize-1);
+  gv.ids[i]=layer;
+  gv.idused++;
+  return 1;
+}
+
+static void idDel(SILLYR *layer) {
+  UINT i,j,home;
+
+  if (0==gv.idsize) return;
+  i=idSlot(layer->id);
+  while ((gv.ids[i])&&(gv.ids[i]!=layer)) i=(i+1)&(gv.idsize-1);
+  if (NULL==gv.ids[i]) return;
+  gv.ids[i]=NULL;
+  gv.idused--;
+
+  /* move following entries back if their own slot is at or before the gap */
+  j=i;
+  while (1) {
+    j=(j+1)&(gv.idsize-1);
+    if (NULL==gv.ids[j]) break;
+    home=idSlot(gv.ids[j]->id);
+    if (((j-home)&(gv.idsize-1))>=((j-i)&(gv.idsize-1))) {
+      gv.ids[i]=gv.ids[j];
+      gv.ids[j]=NULL;
+      i=j;
+    }
+  }
+}
+
+
+/*****************************************************************************
+
+  Internal functions for allocating layers.
+
+  Layers are taken from slabs of SILPOOL_SLAB layers each, instead of 
+  allocating them one by one, keeping them close together in memory. Slabs 
+  are never released or moved, so pointers to layers stay valid. Destroyed 
+  layers are put on a list of unused ones, to be reused first.
+
+ *****************************************************************************/
+
+static SILLYR *poolAlloc() {
+  GSLAB *slab;
+  SILLYR *layer;
+
+  if (NULL==gv.unused) {
+    slab=calloc(1,sizeof(GSLAB));
+    if (NULL==slab) return NULL;
+    slab->next=gv.slabs;
+    gv.slabs=slab;
+    /* add them in reverse, so first one will be used first */
+    for (int i=SILPOOL_SLAB-1;i>=0;i--) {
+      slab->layer[i].next=gv.unused;
+      gv.unused=&slab->layer[i];
+    }
+  }
+  layer=gv.unused;
+  gv.unused=layer->next;
+  memset(layer,0,sizeof(SILLYR));
+  return layer;
+}
+
+static void poolFree(SILLYR *layer) {
+  memset(layer,0,sizeof(SILLYR));
+  layer->next=gv.unused;
+  gv.unused=layer;
+}
 
 
 /* Group: Creating and destroying */
@@ -108,89 +537,621 @@ Remarks:
   
 
 */
-SILLYR *sil_addLayer(int relx, int rely, UINT width, UINT height, BYTE type) {
+SILLYR *sil_addLayer(int relx, int rely, UINT width, UINT height, BYTE type) {
+  SILLYR *layer=NULL;
+
+  layer=poolAlloc();
+  if (NULL==layer) {
+    log_info("ERR: Can't allocate memory for addLayer");
+    return NULL;
+  }
+
+  /* if no type is given - '0' - use type of framebuffer of display for best performance */
+  /* and maximum colordepth                                                              */
+  if (0==type) type=sil_getTypefromDisplay();
+
+  /* create framebuffer for that layer */
+  layer->fb=sil_initFB(width, height, type);
+  if (NULL==layer->fb) {
+    log_info("ERR: Can't create framebuffer for added layer");
+    poolFree(layer);
+    return NULL;
+  }
+
+  /* add layer to double linked list of layers */
+  layer->next=NULL;
+  if (gv.top) {
+    gv.top->next=layer;
+    layer->previous=gv.top;
+  } else {
+    gv.bottom=layer;
+    layer->previous=NULL;
+  }
+  gv.top=layer;
+  gv.zdirty=1;
+
+  /* set the other parameters to default */
+  layer->view.minx=0;
+  layer->view.miny=0;
+  layer->view.width=width;
+  layer->view.height=height;
+  layer->relx=relx;
+  layer->rely=rely;
+  layer->alpha=1;
+  layer->flags=0;
+  layer->internal=0;
+  layer->orient=SILROT_NONE;
+  layer->id=gv.idcount++;
+  idAdd(layer);
+  layer->texture=NULL;
+  layer->user=NULL;
+  layer->hover=NULL;
+  layer->click=NULL;
+  layer->keypress=NULL;
+  layer->drag=NULL;
+  layer->pointer=NULL;
+  layer->key=0;
+  layer->modifiers=0;
+  layer->sprite.width=0;
+  layer->sprite.height=0;
+  layer->sprite.pos=0;
+  layer->xform.scalex=1;
+  layer->xform.scaley=1;
+  layer->xform.angle=0;
+  layer->xform.cosa=1;
+  layer->xform.sina=0;
+
+  layer->init=1;
+  return layer;
+}
+
+/*****************************************************************************
+
+  internal function :
+    copies the relevant information from one layer to another one
+
+ *****************************************************************************/
+static void copylayerinfo(SILLYR *from, SILLYR *to) {
+  to->view.minx= from->view.minx; 
+  to->view.miny= from->view.miny; 
+  to->view.width= from->view.width; 
+  to->view.height= from->view.height; 
+  to->orient= from->orient;
+  if (sil_checkFlags(from,SILFLAG_INVISIBLE)) sil_setFlags(to,SILFLAG_INVISIBLE);
+  if (sil_checkFlags(from,SILFLAG_DRAGGABLE)) sil_setFlags(to,SILFLAG_DRAGGABLE);
+  if (sil_checkFlags(from,SILFLAG_VIEWPOSSTAY)) sil_setFlags(to,SILFLAG_VIEWPOSSTAY);
+  if (sil_checkFlags(from,SILFLAG_SMOOTH)) sil_setFlags(to,SILFLAG_SMOOTH);
+  if (from->internal & SILKT_SINGLE) to->internal|=SILKT_SINGLE;
+  if (from->internal & SILKT_ONLYUP) to->internal|=SILKT_ONLYUP;
+  to->hover= from->hover;
+  to->click= from->click;
+  to->keypress= from->keypress;
+  to->key= from->key;
+  to->modifiers= from->modifiers;
+  to->drag= from->drag;
+  to->texture=from->texture;
+  to->sprite.width= from->sprite.width; 
+  to->sprite.height= from->sprite.height; 
+  to->sprite.pos= from->sprite.pos; 
+  to->xform= from->xform;
+}
+
+
+/*
+Function: sil_addTiledLayer
+  Create a layer for very large images, with pixels stored in tiles
+
+Parameters: 
+  relx   - x position relative to top left of display
+  rely   - y position relative to top left of display
+  width  - width of layer
+  height - height of layer
+  type   - RGB type to store (see: <RGB types>). Use '0' to use same type as the one from the display.
+  loader - optional function to supply content of tiles, or NULL
+
+Returns:
+  pointer to created layer or NULL if error occured
+
+Remarks:
+  - Memory for pixels isn't allocated at once, but in tiles of 256x256 pixels, only when 
+    they are drawn upon. Parts never drawn are transparent. Width and height can therefore 
+    be far larger then available memory, like maps, schematics or long documents.
+  - Use <sil_setView()> to select the part to show, only tiles within that part are used
+    when drawing the display.
+  - If a loader is given, it will be called the first time a tile is needed with the layer, 
+    an empty framebuffer for the tile and its column and row (x/256 and y/256). It should 
+    draw into the framebuffer with <sil_putPixelFB()> and return 1, or return 0 to leave 
+    tile empty. 
+  - <sil_clearLayer()> throws away all tiles, so loader will be called again for them.
+  - Functions that need a single buffer, like <sil_addCopy()>, <sil_resizeLayer()>, 
+    <sil_rotateLayer()>, hitmasks or the blur filter don't work on tiled layers.
+  - For grids of small repeating images, like boards or backgrounds, use 
+    <sil_addTileMapLayer()> instead, for many small moving images <sil_addBatchLayer()>.
+
+*/
+SILLYR *sil_addTiledLayer(int relx, int rely, UINT width, UINT height, BYTE type, UINT (*loader)(SILLYR *, SILFB *, UINT, UINT)) {
+  SILLYR *layer=NULL;
+  SILFB *fb;
+
+  if (0==type) type=sil_getTypefromDisplay();
+  fb=sil_initTiledFB(width,height,type);
+  if (NULL==fb) {
+    log_info("ERR: Can't create tiled framebuffer for added layer");
+    return NULL;
+  }
+
+  /* create layer of size 1x1, since fb will be replaced */
+  layer=sil_addLayer(relx,rely,1,1,type);
+  if (NULL==layer) {
+    sil_destroyFB(fb);
+    return NULL;
+  }
+  sil_destroyFB(layer->fb);
+  layer->fb=fb;
+  layer->view.width=width;
+  layer->view.height=height;
+  if (loader) sil_setTileLoaderFB(fb,loader,layer);
+  return layer;
+}
+
+
+/*
+Function: sil_addTileMapLayer
+  Create a layer that shows a grid of tiles, taken from a tileset
+
+Parameters: 
+  relx    - x position relative to top left of display
+  rely    - y position relative to top left of display
+  tileset - layer containing all tiles, next to and below each other
+  tilew   - width of a single tile
+  tileh   - height of a single tile
+  cols    - amount of columns of grid
+  rows    - amount of rows of grid
+
+Returns:
+  pointer to created layer or NULL if error occured
+
+Remarks:
+  - Tiles within the tileset are numbered from left to right, top to bottom, starting 
+    with 0. Use <sil_setTileMap()> to set the tile shown in each cell. All cells start 
+    empty (SILMAP_NONE), showing nothing.
+  - Layer is cols*tilew by rows*tileh pixels. No pixels are stored for it, they are 
+    taken from tileset when drawn, so a board of hundreds of tiles costs just a single 
+    layer (and a single texture with SDL) instead of a layer per tile.
+  - Tileset layer is used, not copied, so keep it around as long as the tilemap is used.
+    Normally, you would hide it with <sil_hide()>. Changing pixels of tileset doesn't 
+    redraw the tilemap in SDL, unless a cell or the tilemap itself is changed.
+  - Drawing on the layer itself is ignored. Functions that need a single buffer, 
+    like <sil_addCopy()>, <sil_resizeLayer()>, <sil_rotateLayer()> or the blur filter 
+    don't work on tilemap layers.
+  - Use <sil_hitTileMap()> in a mouse handler to find out which cell has been clicked.
+
+*/
+SILLYR *sil_addTileMapLayer(int relx, int rely, SILLYR *tileset, UINT tilew, UINT tileh, UINT cols, UINT rows) {
+  SILLYR *layer=NULL;
+  SILFB *fb;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==tileset)||(NULL==tileset->fb)) {
+    log_warn("adding tilemap layer with uninitialized tileset layer");
+    return NULL;
+  }
+#endif
+  fb=sil_initMapFB(tileset->fb,tilew,tileh,cols,rows);
+  if (NULL==fb) {
+    log_info("ERR: Can't create tilemap framebuffer for added layer");
+    return NULL;
+  }
+
+  /* create layer of size 1x1, since fb will be replaced */
+  layer=sil_addLayer(relx,rely,1,1,fb->type);
+  if (NULL==layer) {
+    sil_destroyFB(fb);
+    return NULL;
+  }
+  sil_destroyFB(layer->fb);
+  layer->fb=fb;
+  layer->view.width=fb->width;
+  layer->view.height=fb->height;
+  sil_updateIndex(layer);
+  return layer;
+}
+
+
+/*
+Function: sil_setTileMap
+  Set tile shown in a cell of a tilemap layer
+
+Parameters: 
+  layer - tilemap layer
+  col   - column of cell
+  row   - row of cell
+  index - number of tile within tileset, or SILMAP_NONE to empty the cell
+
+Remarks:
+  - Only the area of the cell itself is marked as changed, so SDL only updates that 
+    part of the texture.
+
+*/
+void sil_setTileMap(SILLYR *layer, UINT col, UINT row, UINT index) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->map)) {
+    log_warn("setting tile on layer that isn't a tilemap layer");
+    return;
+  }
+#endif
+  sil_setCellFB(layer->fb,col,row,index);
+}
+
+
+/*
+Function: sil_getTileMap
+  Get tile shown in a cell of a tilemap layer
+
+Parameters: 
+  layer - tilemap layer
+  col   - column of cell
+  row   - row of cell
+
+Returns:
+  Number of tile within tileset or SILMAP_NONE if cell is empty or outside grid
+
+*/
+UINT sil_getTileMap(SILLYR *layer, UINT col, UINT row) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->map)) {
+    log_warn("getting tile of layer that isn't a tilemap layer");
+    return SILMAP_NONE;
+  }
+#endif
+  return sil_getCellFB(layer->fb,col,row);
+}
+
+
+/*
+Function: sil_fillTileMap
+  Set all cells of a tilemap layer to the same tile
+
+Parameters: 
+  layer - tilemap layer
+  index - number of tile within tileset, or SILMAP_NONE to empty all cells
+
+*/
+void sil_fillTileMap(SILLYR *layer, UINT index) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->map)) {
+    log_warn("filling tiles of layer that isn't a tilemap layer");
+    return;
+  }
+#endif
+  sil_fillCellsFB(layer->fb,index);
+}
+
+
+/*
+Function: sil_repeatTileMap
+  Repeat grid of a tilemap layer over given area, for example to cover a background
+
+Parameters: 
+  layer  - tilemap layer
+  width  - width of area to cover, or 0 to stop repeating 
+  height - height of area to cover, or 0 to stop repeating
+
+Remarks:
+  - Layer becomes width x height pixels and the grid is repeated, starting at top left,
+    as often as needed to fill it. A grid of 1x1 cells just repeats a single tile.
+  - Cells keep their column and row within the grid, so changing a cell changes all 
+    repeated copies of it.
+  - View of the layer is reset to the whole layer.
+
+*/
+void sil_repeatTileMap(SILLYR *layer, UINT width, UINT height) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->map)) {
+    log_warn("repeating layer that isn't a tilemap layer");
+    return;
+  }
+#endif
+  sil_repeatMapFB(layer->fb,width,height);
+  layer->view.minx=0;
+  layer->view.miny=0;
+  layer->view.width=layer->fb->width;
+  layer->view.height=layer->fb->height;
+  sil_updateIndex(layer);
+}
+
+
+/*
+Function: sil_addBatchLayer
+  Create a layer holding many lightweight sprites, all taken from a single spritesheet
+
+Parameters: 
+  relx   - x position relative to top left of display
+  rely   - y position relative to top left of display
+  width  - width of layer
+  height - height of layer
+  sheet  - layer with sprites, initialized with <sil_initSpriteSheet()>
+
+Returns:
+  pointer to created layer or NULL if error occured
+
+Remarks:
+  - Use <sil_addBatchSprite()> to add sprites. Each sprite has its own position (relative 
+    to top left of layer), frame within the spritesheet (counting like <sil_setSprite()>), 
+    alpha and flags, but it isn't a layer of its own. So thousands of them, like particles, 
+    are drawn and hittested as a single layer (and a single texture with SDL).
+  - Sprites added later are drawn on top of earlier ones. Parts outside the layer are cut off.
+  - Changing a sprite only marks its old and new area as changed.
+  - Sheet layer is used, not copied, so keep it around as long as the batch is used.
+    Normally, you would hide it with <sil_hide()>.
+  - <sil_clearLayer()> removes all sprites, drawing on the layer itself is ignored. 
+    Functions that need a single buffer, like <sil_addCopy()>, <sil_resizeLayer()>, 
+    <sil_rotateLayer()> or the blur filter don't work on batch layers.
+  - Use <sil_hitBatchSprite()> in a mouse handler to find out which sprite has been clicked.
+
+*/
+SILLYR *sil_addBatchLayer(int relx, int rely, UINT width, UINT height, SILLYR *sheet) {
+  SILLYR *layer=NULL;
+  SILFB *fb;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==sheet)||(NULL==sheet->fb)) {
+    log_warn("adding batch layer with uninitialized sheet layer");
+    return NULL;
+  }
+  if ((0==sheet->sprite.width)||(0==sheet->sprite.height)) {
+    log_warn("adding batch layer with sheet that isn't initialized as spritesheet");
+    return NULL;
+  }
+#endif
+  fb=sil_initBatchFB(sheet->fb,sheet->sprite.width,sheet->sprite.height,width,height);
+  if (NULL==fb) {
+    log_info("ERR: Can't create batch framebuffer for added layer");
+    return NULL;
+  }
+
+  /* create layer of size 1x1, since fb will be replaced */
+  layer=sil_addLayer(relx,rely,1,1,fb->type);
+  if (NULL==layer) {
+    sil_destroyFB(fb);
+    return NULL;
+  }
+  sil_destroyFB(layer->fb);
+  layer->fb=fb;
+  layer->view.width=width;
+  layer->view.height=height;
+  sil_updateIndex(layer);
+  return layer;
+}
+
+
+/*
+Function: sil_addBatchSprite
+  Add sprite to a batch layer
+
+Parameters: 
+  layer - batch layer
+  x     - x position of sprite, relative to top left of layer
+  y     - y position of sprite, relative to top left of layer
+  frame - sprite within spritesheet to show
+
+Returns:
+  id of the new sprite, or SILBATCH_NONE if it couldn't be added
+
+Remarks:
+  - Ids of removed sprites are reused.
+
+*/
+UINT sil_addBatchSprite(SILLYR *layer, int x, int y, UINT frame) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("adding sprite to layer that isn't a batch layer");
+    return SILBATCH_NONE;
+  }
+#endif
+  return sil_addSpriteFB(layer->fb,x,y,frame);
+}
+
+
+/*
+Function: sil_setBatchSprite
+  Move sprite of a batch layer and/or change its frame or alpha
+
+Parameters: 
+  layer - batch layer
+  id    - id of sprite, as returned by <sil_addBatchSprite()>
+  x     - new x position of sprite, relative to top left of layer
+  y     - new y position of sprite, relative to top left of layer
+  frame - sprite within spritesheet to show
+  alpha - alpha of whole sprite, 0 (invisible) - 255 (only alpha of sheet itself)
+
+*/
+void sil_setBatchSprite(SILLYR *layer, UINT id, int x, int y, UINT frame, BYTE alpha) {
+  BYTE flags=0;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("setting sprite of layer that isn't a batch layer");
+    return;
+  }
+#endif
+  if (SILERR_ALLOK!=sil_getSpriteFB(layer->fb,id,NULL,NULL,NULL,NULL,&flags)) {
+    log_warn("setting sprite %d that isn't part of batch layer",id);
+    return;
+  }
+  sil_setSpriteFB(layer->fb,id,x,y,frame,alpha,flags);
+}
+
+
+/*
+Function: sil_getBatchSprite
+  Get position, frame and alpha of sprite of a batch layer
+
+Parameters: 
+  layer - batch layer
+  id    - id of sprite
+  x     - pointer to store x position, or NULL
+  y     - pointer to store y position, or NULL
+  frame - pointer to store frame, or NULL
+  alpha - pointer to store alpha, or NULL
+
+Returns:
+  SILERR_ALLOK or SILERR_WRONGFORMAT if there is no sprite with that id
+
+*/
+UINT sil_getBatchSprite(SILLYR *layer, UINT id, int *x, int *y, UINT *frame, BYTE *alpha) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("getting sprite of layer that isn't a batch layer");
+    return SILERR_NOTINIT;
+  }
+#endif
+  return sil_getSpriteFB(layer->fb,id,x,y,frame,alpha,NULL);
+}
+
+
+/*
+Function: sil_flagBatchSprite
+  Set flags of sprite of a batch layer
+
+Parameters: 
+  layer - batch layer
+  id    - id of sprite
+  flags - combination of SILSPRITE_HIDDEN (don't draw) and SILSPRITE_NOHIT (ignored 
+          by <sil_hitBatchSprite()>), or 0
+
+*/
+void sil_flagBatchSprite(SILLYR *layer, UINT id, BYTE flags) {
+  int x,y;
+  UINT frame;
+  BYTE alpha;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("setting flags of sprite of layer that isn't a batch layer");
+    return;
+  }
+#endif
+  if (SILERR_ALLOK!=sil_getSpriteFB(layer->fb,id,&x,&y,&frame,&alpha,NULL)) {
+    log_warn("setting flags of sprite %d that isn't part of batch layer",id);
+    return;
+  }
+  sil_setSpriteFB(layer->fb,id,x,y,frame,alpha,flags);
+}
+
+
+/*
+Function: sil_removeBatchSprite
+  Remove sprite from a batch layer
+
+Parameters: 
+  layer - batch layer
+  id    - id of sprite
+
+*/
+void sil_removeBatchSprite(SILLYR *layer, UINT id) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("removing sprite of layer that isn't a batch layer");
+    return;
+  }
+#endif
+  sil_removeSpriteFB(layer->fb,id);
+}
+
+
+/*
+Function: sil_addNineSliceLayer
+  Create a layer that draws a frame (button, panel, dialog) of any size from a single image
+
+Parameters: 
+  relx   - x position relative to top left of display
+  rely   - y position relative to top left of display
+  width  - width of layer
+  height - height of layer
+  source - layer with image of the frame
+  left   - width of left border within source
+  top    - height of top border within source
+  right  - width of right border within source
+  bottom - height of bottom border within source
+  mode   - SILSLICE_STRETCH to stretch edges and center, SILSLICE_TILE to repeat them
+
+Returns:
+  pointer to created layer or NULL if error occured
+
+Remarks:
+  - Source is divided in 3x3 parts by the borders. Corners are drawn as they are, the 
+    edges and the center are stretched or repeated to fill the rest of the layer.
+  - No pixels are stored for the layer, they are taken from source when drawn. Use 
+    <sil_resizeNineSlice()> (or <sil_rescale()>) to change size at any time, without 
+    costing any memory or losing the corners.
+  - Source layer is used, not copied, so keep it around as long as the layer is used.
+    Normally, you would hide it with <sil_hide()>. Multiple nine-slice layers can use 
+    the same source.
+  - Drawing on the layer itself is ignored. Functions that need a single buffer, 
+    like <sil_addCopy()>, <sil_resizeLayer()>, <sil_rotateLayer()> or the blur filter 
+    don't work on nine-slice layers.
+
+*/
+SILLYR *sil_addNineSliceLayer(int relx, int rely, UINT width, UINT height, SILLYR *source, 
+    UINT left, UINT top, UINT right, UINT bottom, BYTE mode) {
   SILLYR *layer=NULL;
+  SILFB *fb;
 
-  layer=calloc(1,sizeof(SILLYR));
-  if (NULL==layer) {
-    log_info("ERR: Can't allocate memory for addLayer");
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==source)||(NULL==source->fb)) {
+    log_warn("adding nine-slice layer with uninitialized source layer");
     return NULL;
   }
-
-  /* if no type is given - '0' - use type of framebuffer of display for best performance */
-  /* and maximum colordepth                                                              */
-  if (0==type) type=sil_getTypefromDisplay();
-
-  /* create framebuffer for that layer */
-  layer->fb=sil_initFB(width, height, type);
-  if (NULL==layer->fb) {
-    log_info("ERR: Can't create framebuffer for added layer");
+#endif
+  fb=sil_initSliceFB(source->fb,width,height,left,top,right,bottom,mode);
+  if (NULL==fb) {
+    log_info("ERR: Can't create nine-slice framebuffer for added layer");
     return NULL;
   }
 
-  /* add layer to double linked list of layers */
-  layer->next=NULL;
-  if (gv.top) {
-    gv.top->next=layer;
-    layer->previous=gv.top;
-  } else {
-    gv.bottom=layer;
-    layer->previous=NULL;
+  /* create layer of size 1x1, since fb will be replaced */
+  layer=sil_addLayer(relx,rely,1,1,fb->type);
+  if (NULL==layer) {
+    sil_destroyFB(fb);
+    return NULL;
   }
-  gv.top=layer;
-
-  /* set the other parameters to default */
-  layer->view.minx=0;
-  layer->view.miny=0;
+  sil_destroyFB(layer->fb);
+  layer->fb=fb;
   layer->view.width=width;
   layer->view.height=height;
-  layer->relx=relx;
-  layer->rely=rely;
-  layer->alpha=1;
-  layer->flags=0;
-  layer->internal=0;
-  layer->id=gv.idcount++;
-  layer->texture=NULL;
-  layer->user=NULL;
-  layer->hover=NULL;
-  layer->click=NULL;
-  layer->keypress=NULL;
-  layer->drag=NULL;
-  layer->pointer=NULL;
-  layer->key=0;
-  layer->modifiers=0;
-  layer->sprite.width=0;
-  layer->sprite.height=0;
-  layer->sprite.pos=0;
-
-  layer->init=1;
+  sil_updateIndex(layer);
   return layer;
 }
 
-/*****************************************************************************
 
-  internal function :
-    copies the relevant information from one layer to another one
+/*
+Function: sil_resizeNineSlice
+  Change size of a nine-slice layer
 
- *****************************************************************************/
-static void copylayerinfo(SILLYR *from, SILLYR *to) {
-  to->view.minx= from->view.minx; 
-  to->view.miny= from->view.miny; 
-  to->view.width= from->view.width; 
-  to->view.height= from->view.height; 
-  if (sil_checkFlags(from,SILFLAG_INVISIBLE)) sil_setFlags(to,SILFLAG_INVISIBLE);
-  if (sil_checkFlags(from,SILFLAG_DRAGGABLE)) sil_setFlags(to,SILFLAG_DRAGGABLE);
-  if (sil_checkFlags(from,SILFLAG_VIEWPOSSTAY)) sil_setFlags(to,SILFLAG_VIEWPOSSTAY);
-  if (from->internal & SILKT_SINGLE) to->internal|=SILKT_SINGLE;
-  if (from->internal & SILKT_ONLYUP) to->internal|=SILKT_ONLYUP;
-  to->hover= from->hover;
-  to->click= from->click;
-  to->keypress= from->keypress;
-  to->drag= from->drag;
-  to->texture=from->texture;
-  to->sprite.width= from->sprite.width; 
-  to->sprite.height= from->sprite.height; 
-  to->sprite.pos= from->sprite.pos; 
+Parameters: 
+  layer  - nine-slice layer
+  width  - new width
+  height - new height
+
+Remarks:
+  - View of the layer is reset to the whole layer.
+
+*/
+void sil_resizeNineSlice(SILLYR *layer, UINT width, UINT height) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->slice)) {
+    log_warn("resizing layer that isn't a nine-slice layer");
+    return;
+  }
+#endif
+  if ((0==width)||(0==height)) return;
+  sil_sizeSliceFB(layer->fb,width,height);
+  layer->view.minx=0;
+  layer->view.miny=0;
+  layer->view.width=width;
+  layer->view.height=height;
+  sil_updateIndex(layer);
 }
 
 
@@ -218,13 +1179,21 @@ SILLYR *sil_addCopy(SILLYR *layer,int relx,int rely) {
     return NULL;
   }
 #endif
+  if (NULL==layer->fb->buf) {
+    log_warn("addCopy on layer without a buffer of its own (tiled, tilemap, ...) isn't possible, use sil_addInstance instead");
+    return NULL;
+  }
   ret=sil_addLayer(relx,rely,layer->fb->width,layer->fb->height,layer->fb->type);
   if (NULL==ret) {
     log_warn("Can't create extra layer for addCopy");
     return NULL;
   }
   memcpy(ret->fb->buf,layer->fb->buf,layer->fb->size);
+  ret->fb->originx=layer->fb->originx;
+  ret->fb->originy=layer->fb->originy;
   copylayerinfo(layer,ret);
+  keyIndex(ret,1);
+  sil_updateIndex(ret);
 
   return ret;
 }
@@ -272,7 +1241,7 @@ SILLYR *sil_addInstance(SILLYR *layer,int relx,int rely) {
     log_warn("Can't create extra layer for addCopy");
     return NULL;
   }
-  free(ret->fb);
+  sil_destroyFB(ret->fb);
   ret->fb=layer->fb;
 
   copylayerinfo(layer,ret);
@@ -292,6 +1261,7 @@ SILLYR *sil_addInstance(SILLYR *layer,int relx,int rely) {
   /* if there is still a copy of it left                            */
   layer->internal|=SILFLAG_INSTANCIATED;
   ret->internal|=SILFLAG_INSTANCIATED;
+  sil_updateIndex(ret);
 
   /* For SDL: to be sure, set flag that fb is changed to notify it has to */
   /* render the texture for this layer first                              */
@@ -321,10 +1291,36 @@ Remarks:
   - This function is way faster then <PNGintoLayer()> which will load and put in 
   an existing layer. It will not use a temporary framebuffer but will claim 
   the created framebuffer from the lodepng function as part of the layer.
+  - Use <sil_PNGtoNewLayerType()> to store it in a more compact type.
  */
 SILLYR *sil_PNGtoNewLayer(char *filename,UINT x,UINT y) {
+  return sil_PNGtoNewLayerType(filename,x,y,SILTYPE_ABGR);
+}
+
+/*
+Function: sil_PNGtoNewLayerType
+
+  Like <sil_PNGtoNewLayer()>, but converts the image to given RGB type while loading
+
+Parameters:
+  filename - name of .png file to be loaded
+  x        - x coordinate of new layer
+  y        - y coordinate of new layer
+  type     - RGB type to store (see: <RGB types>). Use '0' to use same type as the one from the display.
+
+Returns:
+  pointer to newly created layer. Pointer is NULL if error occured.
+
+Remarks:
+  - Use SILTYPE_4444ARGB or SILTYPE_1555ARGB to keep transparency of icons and 
+    UI art at half the memory of SILTYPE_ABGR. 
+  - For other types than SILTYPE_ABGR, image is decoded first and converted 
+    afterwards, so for a short moment memory for both is needed.
+ */
+SILLYR *sil_PNGtoNewLayerType(char *filename,UINT x,UINT y,BYTE type) {
   SILLYR *layer=NULL;
   BYTE *image =NULL;
+  uint64_t pos;
   UINT err=0;
   UINT width=0;
   UINT height=0;
@@ -360,13 +1356,26 @@ SILLYR *sil_PNGtoNewLayer(char *filename,UINT x,UINT y) {
     return NULL;
   }
   /* first create layer */
-  layer=sil_addLayer(x,y,width,height,SILTYPE_ABGR);
+  if (0==type) type=sil_getTypefromDisplay();
+  layer=sil_addLayer(x,y,width,height,type);
   if (NULL==layer) {
     log_warn("Can't create layer for loaded PNG file");
     if (image) free(image);
     return NULL;
   }
 
+  if (SILTYPE_ABGR!=type) {
+    /* decoded image is RGBA, same as ABGR, convert it pixel by pixel */
+    for (UINT py=0;py<height;py++) {
+      for (UINT px=0;px<width;px++) {
+        pos=(px+py*width)*4;
+        sil_putPixelFB(layer->fb,px,py,image[pos],image[pos+1],image[pos+2],image[pos+3]);
+      }
+    }
+    free(image);
+    return layer;
+  }
+
   /* free the framebuffer memory */
   if (!(( layer->fb) && (layer->fb->buf))) {
     log_warn("Created layer for PNG has incorrect or missing framebuffer");
@@ -378,6 +1387,7 @@ SILLYR *sil_PNGtoNewLayer(char *filename,UINT x,UINT y) {
   /* and swap the buf with the loaded image */
   layer->fb->buf=image;
   layer->fb->changed=1;
+  layer->fb->version++;
   layer->fb->resized=1;
 
   return layer;
@@ -418,11 +1428,19 @@ void sil_destroyLayer(SILLYR *layer) {
   if ((layer)&&(layer->init)) {
     if (0==hasInstance(layer)) sil_destroyFB(layer->fb);
     layer->init=0;
+    sil_updateIndex(layer);
+    keyIndex(layer,0);
+    idDel(layer);
+    unlinkLayer(layer);
     sil_toBottom(layer);
     gv.bottom=layer->next;
-    layer->next->previous=NULL;
+    if (gv.bottom) {
+      gv.bottom->previous=NULL;
+    } else {
+      gv.top=NULL;
+    }
     if ((layer->flags&SILFLAG_FREEUSER)&&(layer->user)) free(layer->user);
-    free(layer);
+    poolFree(layer);
   } else {
     log_warn("removing non-existing or non-initialized layer");
   }
@@ -466,6 +1484,7 @@ void sil_setHoverHandler(SILLYR *layer, UINT (*hover)(SILEVENT *)) {
   }
 #endif
   layer->hover=hover;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -585,6 +1604,7 @@ void sil_setClickHandler(SILLYR *layer, UINT (*click)(SILEVENT *)) {
   }
 #endif
   layer->click=click;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -659,11 +1679,13 @@ void sil_setKeyHandler(SILLYR *layer, UINT key, BYTE modifiers, BYTE flags, UINT
     return;
   }
 #endif
+  keyIndex(layer,0);
   layer->internal&=~(SILKT_ONLYUP|SILKT_SINGLE);
   layer->internal|=(flags&(SILKT_ONLYUP|SILKT_SINGLE));
   layer->keypress=keypress;
   layer->key=key;
   layer->modifiers=modifiers;
+  keyIndex(layer,1);
 }
 
 
@@ -701,6 +1723,150 @@ void sil_setDragHandler(SILLYR *layer, UINT (*drag)(SILEVENT *)) {
   sil_setFlags(layer,SILFLAG_DRAGGABLE);
 }
 
+/*
+Function: sil_setHitMask
+  
+  Use a precomputed 1 bit mask for deciding if mousepointer is above a visible 
+  pixel of the layer. Pixels with an alpha value above the given threshold are 
+  considered "solid", others will let mouse events through to the layers below.
+
+Parameters: 
+  layer     - layer to use hitmask for
+  threshold - highest alpha value that is still seen as transparent
+
+Remarks:
+  - Mask is build the first time it is needed after pixels of layer have been
+    changed, so drawing on layer doesn't rebuild it for every pixel.
+  - Mask is part of the framebuffer, so all instances of a layer (see <sil_addInstance>)
+    share the same mask and settings.
+  - Without mask, all pixels with alpha above 0 are solid. This also goes for 
+    layers without alpha channel (565, 888 etc.), use <sil_setHitMaskKey> or 
+    <sil_setColorKey> for these.
+  - Has no effect if layer has *SILFLAG_MOUSEALLPIX* set.
+
+*/
+void sil_setHitMask(SILLYR *layer, BYTE threshold) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)) {
+    log_warn("setting hitmask on layer that isn't initialized");
+    return;
+  }
+#endif
+  sil_setMaskFB(layer->fb,SILMASK_ALPHA,threshold,0,0,0);
+}
+
+/*
+Function: sil_setHitMaskKey
+  
+  Like <sil_setHitMask>, but pixels with given color are seen as transparent 
+  for mouse events, all other pixels as solid. Useful for layers without 
+  alpha channel.
+
+Parameters: 
+  layer - layer to use hitmask for
+  red   - red value of color key
+  green - green value of color key
+  blue  - blue value of color key
+
+Remarks:
+  - Color key is converted to the color depth of the layer, so for example 
+    (255,0,255) will match the same pixels on a 565 layer as drawn with that color.
+
+*/
+void sil_setHitMaskKey(SILLYR *layer, BYTE red, BYTE green, BYTE blue) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)) {
+    log_warn("setting hitmask on layer that isn't initialized");
+    return;
+  }
+#endif
+  sil_setMaskFB(layer->fb,SILMASK_KEY,0,red,green,blue);
+}
+
+/*
+Function: sil_clearHitMask
+  
+  Remove hitmask from layer (and its instances) and go back to checking alpha 
+  value of pixels
+
+Parameters: 
+  layer - layer to remove hitmask from
+
+*/
+void sil_clearHitMask(SILLYR *layer) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)) {
+    log_warn("removing hitmask from layer that isn't initialized");
+    return;
+  }
+#endif
+  sil_clearMaskFB(layer->fb);
+}
+
+/*
+Function: sil_setColorKey
+  
+  Make all pixels of the layer with given color transparent, without need for an 
+  alpha channel. 
+
+Parameters: 
+  layer - layer to set colorkey for
+  red   - red value of color to make transparent
+  green - green value of color to make transparent
+  blue  - blue value of color to make transparent
+
+Remarks:
+  - Meant for layers without alpha channel, like 565, 888 or 332, so these can stay 
+    in their compact format and still have transparent parts. Works for other types 
+    as well.
+  - Color is reduced to the colordepth of the layer first, so 255,0,255 matches
+    all pixels that were drawn as 255,0,255 in a 565 layer.
+  - Drawing, hittesting and all displays see these pixels as fully transparent, 
+    but they keep their color, so <sil_clearColorKey()> brings them back. 
+  - Colorkey is part of the framebuffer, so all instances of a layer (see <sil_addInstance>)
+    share the same key.
+  - To use the color of the top left pixel as key, use <sil_getPixelLayer()> first.
+
+*/
+void sil_setColorKey(SILLYR *layer, BYTE red, BYTE green, BYTE blue) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)) {
+    log_warn("setting colorkey on layer that isn't initialized");
+    return;
+  }
+#endif
+  sil_quantizeFB(layer->fb->type,&red,&green,&blue);
+  layer->fb->keyred=red;
+  layer->fb->keygreen=green;
+  layer->fb->keyblue=blue;
+  layer->fb->colorkey=1;
+  layer->fb->changed=1;
+  layer->fb->version++;
+}
+
+/*
+Function: sil_clearColorKey
+  
+  Remove colorkey from layer (and its instances), pixels with that color are 
+  shown again
+
+Parameters: 
+  layer - layer to remove colorkey from
+
+*/
+void sil_clearColorKey(SILLYR *layer) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)) {
+    log_warn("removing colorkey from layer that isn't initialized");
+    return;
+  }
+#endif
+  if (!layer->fb->colorkey) return;
+  layer->fb->colorkey=0;
+  layer->fb->changed=1;
+  layer->fb->version++;
+}
+
 /* Group: Moving */
 /*
 Function: sil_moveLayer
@@ -726,6 +1892,7 @@ void sil_moveLayer(SILLYR *layer,int x,int y) {
 #endif
   layer->relx+=x;
   layer->rely+=y;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -741,6 +1908,7 @@ Parameters:
 Remarks:
   - Coordinates can be negative, meaning drawn (partly) "off screen". 
   Same goes for x,y higher then right lower corner.
+  - If layer is part of a group, position is relative to that group (see <sil_createGroup()>)
   - If you want to stop showing layer, it is still faster and easier to use 
     <sil_hide()> and <sil_show()> instead of setting it outside dimensions of display
 
@@ -755,6 +1923,7 @@ void sil_placeLayer(SILLYR *layer, int x,int y) {
 #endif
   layer->relx=x;
   layer->rely=y;
+  sil_updateIndex(layer);
 }
 
 /* Group: Adjusting */
@@ -772,6 +1941,8 @@ Flags:
   SILFLAG_INVISIBLE   - don't show layer, don't scan for mouse handlers. 
                         Setting and resetting is the same as <sil_hide()> and <sil_show()>
   SILFLAG_NOBLEND     - don't use blend when drawing text
+  SILFLAG_SMOOTH      - use bilinear instead of nearest neighbour sampling when 
+                        layer is scaled or rotated (see <sil_setScaleLayer()>)
   SILFLAG_VIEWPOSSTAY - if view is changed of layer, keep the layer at same position
   SILFLAG_MOUSESHIELD - Stop scanning for layers with mouse handlers under this layer
   SILFLAG_MOUSEALLPIX - When scanning for valid mouse handlers, all pixels of this layer 
@@ -788,6 +1959,7 @@ void sil_setFlags(SILLYR *layer,BYTE flags) {
   }
 #endif
   layer->flags|=flags;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -804,6 +1976,8 @@ Flags:
   SILFLAG_INVISIBLE   - don't show layer, don't scan for mouse handlers. 
                         Setting and resetting is the same as <sil_hide()> and <sil_show()>
   SILFLAG_NOBLEND     - don't use blend when drawing text
+  SILFLAG_SMOOTH      - use bilinear instead of nearest neighbour sampling when 
+                        layer is scaled or rotated (see <sil_setScaleLayer()>)
   SILFLAG_VIEWPOSSTAY - if view is changed of layer, keep the layer at same position
   SILFLAG_MOUSESHIELD - Stop scanning for layers with mouse handlers under this layer
   SILFLAG_MOUSEALLPIX - When scanning for valid mouse handlers, all pixels of this layer 
@@ -820,6 +1994,7 @@ void sil_clearFlags(SILLYR *layer,BYTE flags) {
   }
 #endif
   layer->flags&=~flags;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -836,6 +2011,8 @@ Flags:
   SILFLAG_INVISIBLE   - don't show layer, don't scan for mouse handlers. 
                         Setting and resetting is the same as <sil_hide()> and <sil_show()>
   SILFLAG_NOBLEND     - don't use blend when drawing text
+  SILFLAG_SMOOTH      - use bilinear instead of nearest neighbour sampling when 
+                        layer is scaled or rotated (see <sil_setScaleLayer()>)
   SILFLAG_VIEWPOSSTAY - if view is changed of layer, keep the layer at same position
   SILFLAG_MOUSESHIELD - Stop scanning for layers with mouse handlers under this layer
   SILFLAG_MOUSEALLPIX - When scanning for valid mouse handlers, all pixels of this layer 
@@ -928,6 +2105,7 @@ void sil_setView(SILLYR *layer,UINT minx,UINT miny,UINT width,UINT height) {
     layer->relx+=minx;
     layer->rely+=miny;
   }
+  sil_updateIndex(layer);
 }
 
 /*
@@ -958,6 +2136,7 @@ void sil_resetView(SILLYR *layer) {
   layer->view.miny=0;
   layer->view.width=layer->fb->width;
   layer->view.height=layer->fb->height;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -1002,6 +2181,11 @@ UINT sil_resizeLayer(SILLYR *layer, int minx,int miny,UINT width,UINT height) {
 
   /* no use to create 'empty' sizes... */
   if ((0==width)||(0==height)) return SILERR_WRONGFORMAT;
+  if (NULL==layer->fb->buf) {
+    log_warn("resize of layer without a buffer of its own (tiled, tilemap, ...) isn't possible");
+    return SILERR_WRONGFORMAT;
+  }
+  sil_unwrapFB(layer->fb);
 
   /* create temporary framebuffer to copy from old one into */
   tmpfb=sil_initFB(width,height,layer->fb->type);
@@ -1032,7 +2216,9 @@ UINT sil_resizeLayer(SILLYR *layer, int minx,int miny,UINT width,UINT height) {
   layer->fb->type=tmpfb->type;
   layer->fb->size=tmpfb->size;
   layer->fb->changed=1;
+  layer->fb->version++;
   layer->fb->resized=1;
+  sil_updateIndex(layer);
 
   return SILERR_ALLOK;
 }
@@ -1047,42 +2233,143 @@ Parameters:
   ymove - Amount of pixels to shift down (positive) or up (negative)
 
 Remarks:
-  If will remove any pixels that crosses the boundaries of the layer.
-  It will fill with pixels 0,0,0,0 (black, full transparancy)
+  - If will remove any pixels that crosses the boundaries of the layer.
+    It will fill with pixels 0,0,0,0 (black, full transparancy)
+  - This will copy all pixels within the layer, if you want to shift content
+    often, like scrolling text, use <sil_scrollLayer()> instead.
 
 */
 void sil_shiftLayer(SILLYR *layer,int xmove,int ymove) {
   BYTE red,green,blue,alpha;
-  int sourcex,sourcey,newx,newy;
+  BYTE bpp;
+  BYTE *row;
+  UINT width,height;
+  int sx,sy;
 
   #ifndef SIL_LIVEDANGEROUS
     if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
-      log_warn("resize on layer that isn't initialized, or with uninitialized FB");
+      log_warn("shift on layer that isn't initialized, or with uninitialized FB");
       return;
     }
   #endif
 
-  for (int x=0;x<layer->fb->width;x++) {
-    for (int y=0;y<layer->fb->height;y++) {
-      if (xmove<0) {
-        newx=x-xmove;
-        sourcex=x;
+  width=layer->fb->width;
+  height=layer->fb->height;
+  if ((SIL_ABS(xmove)>=(int)width)||(SIL_ABS(ymove)>=(int)height)) {
+    sil_clearLayer(layer);
+    return;
+  }
+  if ((0==xmove)&&(0==ymove)) return;
+
+  bpp=sil_bytesFB(layer->fb->type);
+  if ((bpp)&&(layer->fb->buf)) {
+    /* move whole rows at once, in order not overwriting rows still needed */
+    sil_unwrapFB(layer->fb);
+    for (UINT i=0;i<height;i++) {
+      int y=(ymove>0)?(int)(height-1-i):(int)i;
+      sy=y-ymove;
+      row=layer->fb->buf+y*width*bpp;
+      if ((sy<0)||(sy>=(int)height)) {
+        memset(row,0,width*bpp);
+        continue;
+      }
+      if (xmove>=0) {
+        memmove(row+xmove*bpp,layer->fb->buf+sy*width*bpp,(width-xmove)*bpp);
+        memset(row,0,xmove*bpp);
       } else {
-        sourcex=(layer->fb->width)-x;
-        newx=sourcex+xmove;
+        memmove(row,layer->fb->buf+sy*width*bpp-xmove*bpp,(width+xmove)*bpp);
+        memset(row+(width+xmove)*bpp,0,-xmove*bpp);
       }
-      if (xmove<0) {
-        newy=y-ymove;
-        sourcey=y;
+    }
+    layer->fb->changed=1;
+    layer->fb->version++;
+    return;
+  }
+
+  /* pixel by pixel, walking against direction of shift */
+  for (UINT i=0;i<height;i++) {
+    int y=(ymove>0)?(int)(height-1-i):(int)i;
+    for (UINT j=0;j<width;j++) {
+      int x=(xmove>0)?(int)(width-1-j):(int)j;
+      sx=x-xmove;
+      sy=y-ymove;
+      if ((sx<0)||(sy<0)||(sx>=(int)width)||(sy>=(int)height)) {
+        sil_putPixelLayer(layer,x,y,0,0,0,0);
       } else {
-        sourcex=(layer->fb->height)-y;
+        sil_getPixelLayer(layer,sx,sy,&red,&green,&blue,&alpha);
+        sil_putPixelLayer(layer,x,y,red,green,blue,alpha);
       }
-      sil_getPixelLayer(layer,sourcex,sourcey,&red,&green,&blue,&alpha);
-      sil_putPixelLayer(layer,newx,newy,red,green,blue,alpha);
     }
   }
 }
 
+/* 
+Function: sil_scrollLayer
+  Scroll content of layer, without moving any pixels
+
+Parameters: 
+  layer - Layer to scroll
+  xmove - Amount of pixels to scroll right (positive) or left (negative)
+  ymove - Amount of pixels to scroll down (positive) or up (negative)
+
+Remarks:
+  - Result is the same as <sil_shiftLayer()>, but instead of copying pixels, 
+    framebuffer of layer is used as "ringbuffer". Only the origin within the 
+    buffer changes, so time needed doesn't depend on size of the layer. 
+  - Pixels that scroll out on one side, would come back on the other side, therefore 
+    these parts are cleared (set to 0,0,0,0) and can be drawn with new content 
+    afterwards. For example, scrolling up 10 pixels (ymove=-10) clears the bottom 10 rows.
+  - All drawing functions keep using positions relative to upper left corner of 
+    layer, so drawing doesn't need to take care of the current origin.
+  - Instances of a layer share the framebuffer, so will be scrolled as well.
+  - Only works for layers with pixels of their own (normal and tiled layers), 
+    tilemap, batch and nine-slice layers can't be scrolled this way.
+
+*/
+void sil_scrollLayer(SILLYR *layer,int xmove,int ymove) {
+  SILFB *fb;
+  UINT width,height;
+  UINT minx,miny,maxx,maxy;
+
+  #ifndef SIL_LIVEDANGEROUS
+    if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+      log_warn("scroll on layer that isn't initialized, or with uninitialized FB");
+      return;
+    }
+  #endif
+
+  fb=layer->fb;
+  if ((NULL==fb->buf)&&(NULL==fb->tiles)) {
+    log_warn("scroll on layer without pixels of its own (tilemap, batch, nine-slice) isn't possible");
+    return;
+  }
+  width=fb->width;
+  height=fb->height;
+  if ((SIL_ABS(xmove)>=(int)width)||(SIL_ABS(ymove)>=(int)height)) {
+    sil_clearLayer(layer);
+    return;
+  }
+  if ((0==xmove)&&(0==ymove)) return;
+
+  /* pixel x,y of layer shows what was at x-xmove,y-ymove */
+  fb->originx=(fb->originx+width-xmove)%width;
+  fb->originy=(fb->originy+height-ymove)%height;
+  fb->changed=1;
+  fb->version++;
+
+  /* clear the rows and columns that came in */
+  if (ymove) {
+    miny=(ymove>0)?0:height+ymove;
+    maxy=(ymove>0)?(UINT)ymove:height;
+    for (UINT y=miny;y<maxy;y++) sil_fillRowLayer(layer,0,y,width,0,0,0,0);
+  }
+  if (xmove) {
+    minx=(xmove>0)?0:width+xmove;
+    maxx=(xmove>0)?(UINT)xmove:width;
+    for (UINT y=0;y<height;y++) sil_fillRowLayer(layer,minx,y,maxx-minx,0,0,0,0);
+  }
+}
+
 
 
 /*----- */
@@ -1168,45 +2455,154 @@ void VertSkew(SILFB *src, SILFB *dest, UINT col, int offset, double weight) {
   while(++i < dest->height) sil_putPixelFB(dest,col,i,0,0,0,0);
 }
 
+/*****************************************************************************
+
+  Internal functions to translate positions on display to pixels in layer.
+  Since a layer can be oriented (see sil_rotate90/180/270), the area it covers
+  on display - its 'footprint' - isn't always the same as its view. 
+
+  footprint : get width & height of area the layer covers on display
+  mapLayer  : translate position within footprint (0,0 is relx,rely) to 
+              x,y position within layer
+
+ *****************************************************************************/
+static void footprint(SILLYR *layer, UINT *width, UINT *height) {
+  if (layer->orient&1) {
+    /* 90 or 270 degrees, swap width & height */
+    *width=layer->view.height;
+    *height=layer->view.width;
+  } else {
+    *width=layer->view.width;
+    *height=layer->view.height;
+  }
+}
+
+static inline void mapLayer(SILLYR *layer, UINT lx, UINT ly, UINT *x, UINT *y) {
+  switch (layer->orient) {
+    case SILROT_90:
+      *x=layer->view.width-1-ly;
+      *y=lx;
+      break;
+    case SILROT_180:
+      *x=layer->view.width-1-lx;
+      *y=layer->view.height-1-ly;
+      break;
+    case SILROT_270:
+      *x=ly;
+      *y=layer->view.height-1-lx;
+      break;
+    default:
+      *x=lx;
+      *y=ly;
+      break;
+  }
+  *x+=layer->view.minx;
+  *y+=layer->view.miny;
+}
+
+/* internal function, is layer scaled or rotated when drawn ? */
+static inline int isTransformed(SILLYR *layer) {
+  return ((1!=layer->xform.scalex)||(1!=layer->xform.scaley)||(0!=layer->xform.sina)||(1!=layer->xform.cosa));
+}
+
+/* floor() without need of math library */
+static inline int ifloor(float f) {
+  int i=(int)f;
+  return (f<i)?i-1:i;
+}
+
+/*****************************************************************************
+
+  Internal function, get bounding box of area the layer covers on display, 
+  including any scaling and rotation
+
+ *****************************************************************************/
+static void screenBox(SILLYR *layer, int *x, int *y, UINT *width, UINT *height) {
+  UINT fw,fh;
+  int ox,oy;
+  float cx,cy,ex,ey,hw,hh;
+
+  footprint(layer,&fw,&fh);
+  origin(layer,&ox,&oy);
+  if (!isTransformed(layer)) {
+    *x=ox;
+    *y=oy;
+    *width=fw;
+    *height=fh;
+    return;
+  }
+  hw=layer->xform.scalex*fw/2;
+  hh=layer->xform.scaley*fh/2;
+  cx=ox+(float)fw/2;
+  cy=oy+(float)fh/2;
+  ex=SIL_ABS(hw*layer->xform.cosa)+SIL_ABS(hh*layer->xform.sina);
+  ey=SIL_ABS(hw*layer->xform.sina)+SIL_ABS(hh*layer->xform.cosa);
+  *x=ifloor(cx-ex);
+  *y=ifloor(cy-ey);
+  *width=ifloor(cx+ex)-*x+1;
+  *height=ifloor(cy+ey)-*y+1;
+}
+
+/*****************************************************************************
+
+  Internal function, translate position on display to (non-integer) position
+  within footprint of transformed layer, using inverse of scale and rotation
+  (around center of footprint). Given for center of pixel at x,y and returns
+  increments for each step in x direction, so callers can walk a row with
+  additions only
+
+ *****************************************************************************/
+static void inverseLayer(SILLYR *layer, int x, int y, float *u, float *v, float *du, float *dv) {
+  UINT fw,fh;
+  int ox,oy;
+  float dx,dy;
+
+  footprint(layer,&fw,&fh);
+  origin(layer,&ox,&oy);
+  dx=(float)x+0.5f-(ox+(float)fw/2);
+  dy=(float)y+0.5f-(oy+(float)fh/2);
+  *u=( dx*layer->xform.cosa+dy*layer->xform.sina)/layer->xform.scalex+(float)fw/2;
+  *v=(-dx*layer->xform.sina+dy*layer->xform.cosa)/layer->xform.scaley+(float)fh/2;
+  if (du) *du= layer->xform.cosa/layer->xform.scalex;
+  if (dv) *dv=-layer->xform.sina/layer->xform.scaley;
+}
+
+/* internal function, rotate orientation of layer with 'steps' times 90 degrees */
+static UINT orientLayer(SILLYR *layer, BYTE steps) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("rotating layer that isn't initialized, or with uninitialized FB");
+    return SILERR_NOTINIT;
+  }
+#endif
+  layer->orient=(layer->orient+steps)&3;
+  sil_updateIndex(layer);
+
+  /* For SDL: orientation of texture is set when rendering, nothing to update */
+  return SILERR_ALLOK;
+}
+
 /*
 Function: sil_rotate90
-  Rotates layer 90 degrees
+  Rotates layer 90 degrees (counterclockwise)
 
 Parameters:
   layer - Layer to rotate
 
+Returns:
+  SILERR_ALLOK or error code
+
 Remark:
-  This function might resize the layer, therefore view settings might
-  not be correct after this, use <sil_resetView()> if needed
+  - Pixels of the layer aren't moved, only the orientation of the layer is changed 
+    and used when drawing it on display. So this is fast and doesn't need any memory.
+  - Positions used to draw on the layer (and views) are still relative to the 
+    original, unrotated, layer.
+  - Layer will cover an area on display with width and height of view swapped, 
+    starting at same relx,rely position
   If compiled with SIL_NO_MATH option, this rotating function will still work
 */
 UINT sil_rotate90(SILLYR *layer) {
-  SILFB *dest=NULL;
-  BYTE sr,sg,sb,sa; /* source */
-  UINT x,y;
-
-#ifndef SIL_LIVEDANGEROUS
-  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
-    log_warn("resetView on layer that isn't initialized, or with uninitialized FB");
-    return SILERR_NOTINIT;
-  }
-#endif
-
-  dest=sil_initFB(layer->fb->width,layer->fb->height,layer->fb->type);
-  if (NULL==dest) {
-    log_info("WARN: can't get memory temporary buffer for rotating");
-    return SILERR_NOMEM;
-  }
-  for (y=0;y<layer->fb->height;y++) {
-    for (x=0;x<layer->fb->width;x++) {
-      sil_getPixelLayer(layer,x,y,&sr,&sg,&sb,&sa);
-      sil_putPixelFB(dest,y,(dest->height)-x-1,sr,sg,sb,sa);
-    }
-  }
-  sil_destroyFB(layer->fb);
-  layer->fb=dest;
-
-  return SILERR_ALLOK;
+  return orientLayer(layer,SILROT_90);
 }
 
 
@@ -1217,70 +2613,34 @@ Function: sil_rotate180
 Parameters:
   layer - Layer to rotate
 
+Returns:
+  SILERR_ALLOK or error code
+
 Remark:
+  - Like <sil_rotate90()>, only orientation of the layer is changed, not the pixels
   If compiled with SIL_NO_MATH option, this rotating function will still work
 */
 UINT sil_rotate180(SILLYR *layer) {
-  SILFB *dest=NULL;
-  BYTE sr,sg,sb,sa; /* source */
-  UINT x,y;
-
-#ifndef SIL_LIVEDANGEROUS
-  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
-    log_warn("resetView on layer that isn't initialized, or with uninitialized FB");
-    return SILERR_NOTINIT;
-  }
-#endif
-
-  dest=sil_initFB(layer->fb->width,layer->fb->height,layer->fb->type);
-  if (NULL==dest) {
-    log_info("WARN: can't get memory temporary buffer for rotating");
-    return SILERR_NOMEM;
-  }
-  for (y=0;y<layer->fb->height;y++) {
-    for (x=0;x<layer->fb->width;x++) {
-      sil_getPixelLayer(layer,x,y,&sr,&sg,&sb,&sa);
-      sil_putPixelFB(dest,(dest->width)-x-1,(dest->height)-y-1,sr,sg,sb,sa);
-    }
-  }
-  sil_destroyFB(layer->fb);
-  layer->fb=dest;
-
-  return SILERR_ALLOK;
+  return orientLayer(layer,SILROT_180);
 }
 
 
 /*
 Function: sil_rotate270
-  Rotates layer 270 degrees
+  Rotates layer 270 degrees (counterclockwise), same as 90 degrees clockwise
 
 Parameters:
   layer - Layer to rotate
 
+Returns:
+  SILERR_ALLOK or error code
+
 Remark:
-  This function might resize the layer, therefore view settings might
-  not be correct after this, use <sil_resetView()> if needed
+  - Like <sil_rotate90()>, only orientation of the layer is changed, not the pixels
   If compiled with SIL_NO_MATH option, this rotating function will still work
 */
 UINT sil_rotate270(SILLYR *layer) {
-  SILFB *dest=NULL;
-  BYTE sr,sg,sb,sa; /* source */
-  UINT x,y;
-
-  dest=sil_initFB(layer->fb->width,layer->fb->height,layer->fb->type);
-  if (NULL==dest) {
-    log_info("WARN: can't get memory temporary buffer for rotating");
-    return SILERR_NOMEM;
-  }
-  for (y=0;y<layer->fb->height;y++) {
-    for (x=0;x<layer->fb->width;x++) {
-      sil_getPixelLayer(layer,x,y,&sr,&sg,&sb,&sa);
-      sil_putPixelFB(dest,(dest->width)-y-1,x,sr,sg,sb,sa);
-    }
-  }
-  sil_destroyFB(layer->fb);
-  layer->fb=dest;
-  return SILERR_NOMEM;
+  return orientLayer(layer,SILROT_270);
 }
 
 #ifndef SIL_NO_MATH
@@ -1297,6 +2657,11 @@ UINT sil_rotate45(SILLYR *layer, double angle) {
 
   /* no rotation at all just copy framebuffer and call it quits */
   if (0.0==angle) return SILERR_ALLOK;
+  if (NULL==layer->fb->buf) {
+    log_warn("rotating layer without a buffer of its own (tiled, tilemap, ...) isn't possible");
+    return SILERR_WRONGFORMAT;
+  }
+  sil_unwrapFB(layer->fb);
 
   drad=angle*SIL_PI/((double)(180.0));
   dsin=sin(drad);
@@ -1448,6 +2813,111 @@ UINT sil_rotateLayer(SILLYR *layer, double angle) {
 }
 #endif
 
+/* Group: Transforming */
+/*
+Function: sil_setScaleLayer
+  Scale layer when drawing it on display 
+
+Parameters:
+  layer  - Layer to scale
+  scalex - horizontal scale factor, 1.0 is original size
+  scaley - vertical scale factor, 1.0 is original size
+
+Remarks:
+  - Unlike <sil_rescale()>, pixels of the layer itself aren't touched, scaling is 
+    done on the fly when drawing the layer, so changing it over and over again 
+    (for zooming or animations) won't make the layer blurry.
+  - Layer is scaled around the center of the area it would cover unscaled, so 
+    relx,rely don't have to be adjusted to keep it in place.
+  - Mouse handlers will react on the scaled area, using same pixel as drawn
+  - It uses nearest neighbour sampling, unless SILFLAG_SMOOTH is set 
+    (see <sil_setFlags()>), then bilinear sampling is used.
+  - Scaling and rotating on non-SDL platforms is done per pixel and slower then 
+    drawing an untransformed layer.
+
+*/
+void sil_setScaleLayer(SILLYR *layer, float scalex, float scaley) {
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("scaling layer that isn't initialized, or with uninitialized FB");
+    return;
+  }
+  if ((scalex<=0)||(scaley<=0)) {
+    log_warn("scaling layer with zero or negative factor");
+    return;
+  }
+#endif
+  layer->xform.scalex=scalex;
+  layer->xform.scaley=scaley;
+  sil_updateIndex(layer);
+}
+
+#ifndef SIL_NO_MATH
+/*
+Function: sil_setAngleLayer
+  Rotate layer with given angle when drawing it on display
+
+Parameters:
+  layer - Layer to rotate
+  angle - Angle in degrees, positive is clockwise
+
+Remarks:
+  - Unlike <sil_rotateLayer()>, pixels of the layer itself aren't touched, rotating 
+    is done on the fly when drawing the layer, so it can be changed over and over 
+    again without making the layer blurry and without any memory costs.
+  - Layer is rotated around the center of the area it would cover unrotated
+  - Rotation is on top of any orientation set by <sil_rotate90()> and friends 
+    and after scaling via <sil_setScaleLayer()>
+  - Not available when compiled with SIL_NO_MATH option
+
+*/
+void sil_setAngleLayer(SILLYR *layer, double angle) {
+  double drad;
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("rotating layer that isn't initialized, or with uninitialized FB");
+    return;
+  }
+#endif
+  while(angle>=360.0) angle-=360.0;
+  while(angle<0.0) angle+=360.0;
+  drad=angle*SIL_PI/((double)(180.0));
+  layer->xform.angle=angle;
+  layer->xform.cosa=cos(drad);
+  layer->xform.sina=sin(drad);
+
+  /* make exact angles exact, so we can skip transforming */
+  if (0.0==angle) {
+    layer->xform.cosa=1;
+    layer->xform.sina=0;
+  }
+  sil_updateIndex(layer);
+}
+#endif
+
+/*
+Function: sil_resetTransformLayer
+  Remove any scaling or rotation set by <sil_setScaleLayer()> or <sil_setAngleLayer()>
+
+Parameters:
+  layer - Layer to reset
+*/
+void sil_resetTransformLayer(SILLYR *layer) {
+#ifndef SIL_LIVEDANGEROUS
+  if (NULL==layer) {
+    log_warn("reset transform on layer that isn't initialized");
+    return;
+  }
+#endif
+  layer->xform.scalex=1;
+  layer->xform.scaley=1;
+  layer->xform.angle=0;
+  layer->xform.cosa=1;
+  layer->xform.sina=0;
+  sil_updateIndex(layer);
+}
+
 
 /*
 Function: sil_hide
@@ -1498,6 +2968,7 @@ void sil_toTop(SILLYR *layer) {
     return;
   }
 #endif
+  gv.zdirty=1;
 
   /* don't move when already on top */
   if (gv.top==layer) return;
@@ -1533,6 +3004,7 @@ void sil_toBottom(SILLYR *layer) {
     return;
   }
 #endif
+  gv.zdirty=1;
 
   /* don't move when already on bottom */
   if (gv.bottom==layer) return;
@@ -1570,6 +3042,7 @@ void sil_toAbove(SILLYR *layer,SILLYR *target) {
     return;
   }
 #endif
+  gv.zdirty=1;
 
   /* moveing above yourself ? */
   if (target==layer) return;
@@ -1603,6 +3076,7 @@ void sil_toAbove(SILLYR *layer,SILLYR *target) {
     if (tnext) tnext->previous=layer;
     target->next=layer;
     if (layer==gv.top) gv.top=lprevious;
+    if (layer==gv.bottom) gv.bottom=lnext;
     return;
 
   }
@@ -1634,6 +3108,7 @@ void sil_toBelow(SILLYR *layer,SILLYR *target) {
     return;
   }
 #endif
+  gv.zdirty=1;
 
   /* moveing below yourself ? */
   if (target==layer) return;
@@ -1668,6 +3143,7 @@ void sil_toBelow(SILLYR *layer,SILLYR *target) {
     if (tprevious) tprevious->next=layer;
     target->previous=layer;
     if (layer==gv.top) gv.top=lprevious;
+    if (layer==gv.bottom) gv.bottom=lnext;
     return;
   }
 
@@ -1697,6 +3173,7 @@ void sil_swap(SILLYR *layer,SILLYR *target) {
     return;
   }
 #endif
+  gv.zdirty=1;
 
   if (target==layer) {
     /* swap with yourself ? nothing to do */
@@ -1783,6 +3260,33 @@ SILLYR *sil_getTop() {
   return gv.top;
 }
 
+/*
+Function: sil_getLayerById
+  find layer by its identifier (layer->id)
+
+Parameters:
+  id - identifier of layer
+
+Returns: 
+  Pointer to layer or NULL if there isn't a layer (anymore) with that id
+
+Remarks:
+  Every layer gets a unique id when created, that won't change when the layer is 
+  moved around, or in the stack, and isn't reused after the layer is destroyed. 
+
+*/
+SILLYR *sil_getLayerById(UINT id) {
+  UINT i;
+
+  if (0==gv.idsize) return NULL;
+  i=idSlot(id);
+  while (gv.ids[i]) {
+    if (gv.ids[i]->id==id) return gv.ids[i];
+    i=(i+1)&(gv.idsize-1);
+  }
+  return NULL;
+}
+
 /* Group: Drawing primitives */
 
 /*
@@ -1837,6 +3341,7 @@ void sil_putPixelLayer(SILLYR *layer, UINT x, UINT y, BYTE red, BYTE green, BYTE
 #endif
   /* don't draw if outside of dimensions of framebuffer */
   if ((x >= layer->fb->width)||(y >= layer->fb->height)) return;
+  ringPos(layer->fb,&x,&y);
   sil_putPixelFB(layer->fb, x,y,red,green,blue,alpha);
 }
 
@@ -1895,6 +3400,39 @@ void sil_blendPixelLayer(SILLYR *layer, UINT x, UINT y, BYTE red, BYTE green, BY
   sil_putPixelLayer(layer,x,y,red,green,blue,alpha);
 }
 
+/*****************************************************************************
+
+  Internal functions, used by drawing functions to write a whole span of 
+  pixels of a row at once. Span is cut off at the right side of the layer 
+  and split in two when the framebuffer is used as ringbuffer. 
+  sil_fillRowLayer replaces pixels, sil_blendRowLayer blends them like 
+  sil_blendPixelLayer, but writes the span at once if color is opaque.
+
+ *****************************************************************************/
+
+void sil_fillRowLayer(SILLYR *layer, UINT x, UINT y, UINT len, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  SILFB *fb=layer->fb;
+  UINT part;
+
+  if ((x>=fb->width)||(y>=fb->height)) return;
+  if (len>fb->width-x) len=fb->width-x;
+  ringPos(fb,&x,&y);
+  part=SIL_MIN(len,fb->width-x);
+  sil_fillRowFB(fb,x,y,part,red,green,blue,alpha);
+  if (part<len) sil_fillRowFB(fb,0,y,len-part,red,green,blue,alpha);
+}
+
+void sil_blendRowLayer(SILLYR *layer, UINT x, UINT y, UINT len, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  if (0==alpha) return;
+  if (255==alpha) {
+    sil_fillRowLayer(layer,x,y,len,red,green,blue,alpha);
+    return;
+  }
+  if ((x>=layer->fb->width)||(y>=layer->fb->height)) return;
+  if (len>layer->fb->width-x) len=layer->fb->width-x;
+  for (UINT i=0;i<len;i++) sil_blendPixelLayer(layer,x+i,y,red,green,blue,alpha);
+}
+
 /*
 Function: sil_getPixelLayer
   
@@ -1917,120 +3455,431 @@ Remarks:
   - If framebuffer type doesn't support alpha value, 255 will be returned.
   - Any pixels that are not within boundaries of layer will be returning zero for all values
 
-*/
-void sil_getPixelLayer(SILLYR *layer, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
-  if ((layer) && (layer->init)) {
-    /* just return transparant black when outside of fb dimensions */
-    if ((x >= layer->fb->width)||(y >= layer->fb->height)) {
-      *red=0;
-      *green=0;
-      *blue=0;
-      *alpha=0;
-    } else {
-      sil_getPixelFB(layer->fb,x,y,red,green,blue,alpha);
-    }
+*/
+void sil_getPixelLayer(SILLYR *layer, UINT x, UINT y, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  if ((layer) && (layer->init)) {
+    /* just return transparant black when outside of fb dimensions */
+    if ((x >= layer->fb->width)||(y >= layer->fb->height)) {
+      *red=0;
+      *green=0;
+      *blue=0;
+      *alpha=0;
+    } else {
+      ringPos(layer->fb,&x,&y);
+      sil_getPixelFB(layer->fb,x,y,red,green,blue,alpha);
+      if ((layer->fb->colorkey)&&(*red==layer->fb->keyred)&&(*green==layer->fb->keygreen)&&(*blue==layer->fb->keyblue)) {
+        *alpha=0;
+      }
+    }
+  }
+}
+
+
+/*
+Function: sil_paintLayer
+  
+  Set all pixels within layer to given color
+
+Parameters:
+  Layer - Layer to paint
+  red   - Red color value of pixel
+  green - Green color value of pixel
+  blue  - Blue color value of pixel
+  alpha - Alpha color value of pixel
+
+*/
+void sil_paintLayer(SILLYR *layer, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+
+#ifndef SIL_LIVEDANGEROUS
+  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
+    log_warn("painting a layer that isn't initialized or has unitialized framebuffer");
+    return;
+  }
+#endif
+
+  for (int x=0;x<layer->fb->width;x++) {
+    for (int y=0;y<layer->fb->height;y++) {
+      sil_putPixelLayer(layer,x,y,red,green,blue,alpha); 
+    }
+  }
+}
+
+
+/*****************************************************************************
+
+  Internal function,draw all layers, from bottom till top, into a single 
+  Framebuffer mostly used by display functions, updating display framebuffer,
+  However can be also be used for making screendumps, testing or generating
+  image .png files
+  This function can be called from display file. Since SDL wil use textures, 
+  and not framebuffer, it is the only one not calling this function.
+
+  sil_LayersToFBWindow does the same, but only for the part of the display 
+  starting at wx,wy with the dimensions of the given framebuffer, and doesn't
+  touch the changed flags of layers. (used for saving display as .png)
+
+ *****************************************************************************/
+
+/* internal function, blend pixel of layer into framebuffer */
+static inline void blendFB(SILFB *fb, float lalpha, UINT x, UINT y, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+  BYTE mixred,mixgreen,mixblue,mixalpha;
+  float af;
+  float negaf;
+
+  if (0==alpha) return; /* nothing to do if completely transparant */
+  alpha=alpha*lalpha;
+  if (255==alpha) {
+    sil_putPixelFB(fb,x,y,red,green,blue,255);
+  } else {
+    /* lets do our own alpha blending */
+    sil_getPixelFB(fb,x,y,&mixred,&mixgreen,&mixblue,&mixalpha);
+    af=((float)alpha)/255;
+    negaf=1-af;
+    red=red*af+negaf*mixred;
+    green=green*af+negaf*mixgreen;
+    blue=blue*af+negaf*mixblue;
+    sil_putPixelFB(fb,x,y,red,green,blue,255);
+  }
+}
+
+/* internal function, get pixel at position within footprint, or transparant if outside */
+static inline void getFootprint(SILLYR *layer, int lx, int ly, UINT fw, UINT fh, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  UINT x,y;
+
+  if ((lx<0)||(ly<0)||(lx>=(int)fw)||(ly>=(int)fh)) {
+    *red=0;
+    *green=0;
+    *blue=0;
+    *alpha=0;
+    return;
+  }
+  mapLayer(layer,lx,ly,&x,&y);
+  sil_getPixelLayer(layer,x,y,red,green,blue,alpha);
+}
+
+/* internal function, bilinear sample at non-integer position within footprint */
+static void sampleBilinear(SILLYR *layer, float u, float v, UINT fw, UINT fh, BYTE *red, BYTE *green, BYTE *blue, BYTE *alpha) {
+  BYTE r[4],g[4],b[4],a[4];
+  float w[4];
+  float fx,fy,sr,sg,sb,sa,wa;
+  int x0,y0;
+
+  /* pixel centers are at .5 */
+  u-=0.5f;
+  v-=0.5f;
+  x0=ifloor(u);
+  y0=ifloor(v);
+  fx=u-x0;
+  fy=v-y0;
+  getFootprint(layer,x0  ,y0  ,fw,fh,&r[0],&g[0],&b[0],&a[0]);
+  getFootprint(layer,x0+1,y0  ,fw,fh,&r[1],&g[1],&b[1],&a[1]);
+  getFootprint(layer,x0  ,y0+1,fw,fh,&r[2],&g[2],&b[2],&a[2]);
+  getFootprint(layer,x0+1,y0+1,fw,fh,&r[3],&g[3],&b[3],&a[3]);
+  w[0]=(1-fx)*(1-fy);
+  w[1]=fx*(1-fy);
+  w[2]=(1-fx)*fy;
+  w[3]=fx*fy;
+
+  /* weight colors with their alpha, so transparant pixels don't darken edges */
+  sr=sg=sb=sa=0;
+  for (int i=0;i<4;i++) {
+    wa=w[i]*a[i];
+    sr+=wa*r[i];
+    sg+=wa*g[i];
+    sb+=wa*b[i];
+    sa+=wa;
+  }
+  if (sa<=0) {
+    *red=0;
+    *green=0;
+    *blue=0;
+    *alpha=0;
+    return;
+  }
+  *red=sr/sa+0.5f;
+  *green=sg/sa+0.5f;
+  *blue=sb/sa+0.5f;
+  *alpha=sa+0.5f;
+}
+
+/* internal function, draw scaled and/or rotated layer using inverse mapping */
+static void drawTransformed(SILFB *fb, SILLYR *layer, float lalpha, int wx, int wy) {
+  BYTE red,green,blue,alpha;
+  UINT fw,fh,bw,bh;
+  int bx,by,minx,miny,maxx,maxy;
+  float u,v,du,dv;
+
+  footprint(layer,&fw,&fh);
+  screenBox(layer,&bx,&by,&bw,&bh);
+  minx=SIL_MAX(bx,wx);
+  miny=SIL_MAX(by,wy);
+  maxx=SIL_MIN(bx+(int)bw,wx+(int)fb->width);
+  maxy=SIL_MIN(by+(int)bh,wy+(int)fb->height);
+
+  for (int y=miny; y<maxy; y++) {
+    inverseLayer(layer,minx,y,&u,&v,&du,&dv);
+    for (int x=minx; x<maxx; x++, u+=du, v+=dv) {
+      if (layer->flags&SILFLAG_SMOOTH) {
+        /* half a pixel margin for soft edges */
+        if ((u<-0.5f)||(v<-0.5f)||(u>=fw+0.5f)||(v>=fh+0.5f)) continue;
+        sampleBilinear(layer,u,v,fw,fh,&red,&green,&blue,&alpha);
+      } else {
+        if ((u<0)||(v<0)||(u>=fw)||(v>=fh)) continue;
+        getFootprint(layer,(int)u,(int)v,fw,fh,&red,&green,&blue,&alpha);
+      }
+      blendFB(fb,lalpha,x-wx,y-wy,red,green,blue,alpha);
+    }
+  }
+}
+
+static void drawLayer(SILFB *fb, SILLYR *layer, float lalpha, int wx, int wy) {
+  BYTE red,green,blue,alpha;
+  UINT fw,fh,x,y;
+  int sx,sy,minx,miny,maxx,maxy;
+
+  if (isTransformed(layer)) {
+    drawTransformed(fb,layer,lalpha,wx,wy);
+    return;
+  }
+
+  /* only draw the part of the footprint that falls within framebuffer */
+  footprint(layer,&fw,&fh);
+  origin(layer,&sx,&sy);
+  sx-=wx;
+  sy-=wy;
+  minx=SIL_MAX(0,-sx);
+  miny=SIL_MAX(0,-sy);
+  maxx=SIL_MIN((int)fw,(int)fb->width-sx);
+  maxy=SIL_MIN((int)fh,(int)fb->height-sy);
+
+  for (int ly=miny; ly<maxy; ly++) {
+    for (int lx=minx; lx<maxx; lx++) {
+      mapLayer(layer,lx,ly,&x,&y);
+      sil_getPixelLayer(layer,x,y,&red,&green,&blue,&alpha);
+      blendFB(fb,lalpha,sx+lx,sy+ly,red,green,blue,alpha);
+    }
+  }
+}
+
+void sil_LayersToFBWindow(SILFB *fb, int wx, int wy) {
+  SILLYR *layer;
+  float alpha;
+
+#ifndef SIL_LIVEDANGEROUS
+  if (0==fb->size) {
+    log_warn("Trying to merge layers to uninitialized framebuffer");
+    return;
+  }
+#endif
+
+  if (gv.zdirty) renumber();
+  sil_clearFB(fb);
+  if (gv.zdirty) {
+    /* no array with stacking order available, use linked list */
+    for (layer=gv.bottom;layer;layer=layer->next) {
+      if (sil_resolveLayer(layer,NULL,NULL,&alpha)) drawLayer(fb,layer,alpha,wx,wy);
+    }
+    return;
+  }
+  for (UINT i=0;i<gv.zcnt;i++) {
+    layer=gv.zorder[i];
+    if (sil_resolveLayer(layer,NULL,NULL,&alpha)) drawLayer(fb,layer,alpha,wx,wy);
+  }
+}
+
+void sil_LayersToFB(SILFB *fb) {
+  SILLYR *layer;
+
+  sil_LayersToFBWindow(fb,0,0);
+  
+  /* clear changed flags, although they are only use by SDL platform at the moment */
+  /* but just to be sure or for further development                                */
+  for (layer=gv.bottom;layer;layer=layer->next) {
+    layer->fb->changed=0;
+    layer->fb->resized=0;
+    layer->fb->damage.width=0;
+  }
+}
+
+/*****************************************************************************
+
+  Internal function, map position x,y on display to position lx,ly within 
+  framebuffer of layer, returns 0 if it is outside footprint of layer 
+
+ *****************************************************************************/
+static int layerAt(SILLYR *layer, UINT x, UINT y, UINT *lx, UINT *ly) {
+  UINT fw,fh;
+  int dx,dy;
+  float u,v;
+
+  footprint(layer,&fw,&fh);
+  if (isTransformed(layer)) {
+    /* map back through scale and rotation, using same pixel as drawn */
+    inverseLayer(layer,x,y,&u,&v,NULL,NULL);
+    if ((u<0)||(v<0)||(u>=fw)||(v>=fh)) return 0;
+    dx=(int)u;
+    dy=(int)v;
+  } else {
+    origin(layer,&dx,&dy);
+    dx=(int)x-dx;
+    dy=(int)y-dy;
+    if ((dx<0)||(dy<0)||(dx>=(int)fw)||(dy>=(int)fh)) return 0;
   }
+  mapLayer(layer,dx,dy,lx,ly);
+  return 1;
 }
 
+/*****************************************************************************
+
+  Internal function, check if position x,y on display is within footprint 
+  of layer and above a visible, non-transparant, pixel (unless layer has 
+  SILFLAG_MOUSEALLPIX set)
+
+ *****************************************************************************/
+static int hitLayer(SILLYR *layer, UINT x, UINT y) {
+  BYTE red,green,blue,alpha;
+  UINT lx,ly;
+
+  if (!layerAt(layer,x,y,&lx,&ly)) return 0;
+
+  /* all pixels within view can be considered as target */
+  if (layer->flags&SILFLAG_MOUSEALLPIX) return 1;
+
+  /* otherwise, use hitmask or fetch pixel info and only target if pixel */
+  /* isn't transparant                                                   */
+  if (layer->fb->mask) {
+    ringPos(layer->fb,&lx,&ly);
+    return sil_hitMaskFB(layer->fb,lx,ly);
+  }
+  sil_getPixelLayer(layer,lx,ly,&red,&green,&blue,&alpha);
+  return (alpha>0);
+}
 
 /*
-Function: sil_paintLayer
-  
-  Set all pixels within layer to given color
+Function: sil_hitTileMap
+  Find cell of a tilemap layer at given position on display
 
-Parameters:
-  Layer - Layer to paint
-  red   - Red color value of pixel
-  green - Green color value of pixel
-  blue  - Blue color value of pixel
-  alpha - Alpha color value of pixel
+Parameters: 
+  layer - tilemap layer
+  x     - x position on display, like the one in mouse events
+  y     - y position on display, like the one in mouse events
+  col   - pointer to store column of cell, or NULL
+  row   - pointer to store row of cell, or NULL
+
+Returns:
+  Number of tile shown in cell, or SILMAP_NONE if cell is empty or position is 
+  outside of layer (col and row aren't set in that case)
+
+Remarks:
+  - Takes view, orientation, scaling, rotation and groups of the layer into account.
+  - In repeat mode (<sil_repeatTileMap()>), column and row are those within the grid.
 
 */
-void sil_paintLayer(SILLYR *layer, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+UINT sil_hitTileMap(SILLYR *layer, UINT x, UINT y, UINT *col, UINT *row) {
+  UINT lx,ly;
 
 #ifndef SIL_LIVEDANGEROUS
-  if ((NULL==layer)||(NULL==layer->fb)||(0==layer->fb->size)) {
-    log_warn("painting a layer that isn't initialized or has unitialized framebuffer");
-    return;
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->map)) {
+    log_warn("hittest of tiles on layer that isn't a tilemap layer");
+    return SILMAP_NONE;
   }
 #endif
-
-  for (int x=0;x<layer->fb->width;x++) {
-    for (int y=0;y<layer->fb->height;y++) {
-      sil_putPixelLayer(layer,x,y,red,green,blue,alpha); 
-    }
-  }
+  if (!layerAt(layer,x,y,&lx,&ly)) return SILMAP_NONE;
+  return sil_cellAtFB(layer->fb,lx,ly,col,row);
 }
 
+/*
+Function: sil_hitBatchSprite
+  Find sprite of a batch layer at given position on display
 
-/*****************************************************************************
+Parameters: 
+  layer - batch layer
+  x     - x position on display, like the one in mouse events
+  y     - y position on display, like the one in mouse events
 
-  Internal function,draw all layers, from bottom till top, into a single 
-  Framebuffer mostly used by display functions, updating display framebuffer,
-  However can be also be used for making screendumps, testing or generating
-  image .png files
-  This function can be called from display file. Since SDL wil use textures, 
-  and not framebuffer, it is the only one not calling this function.
+Returns:
+  id of highest sprite with a non-transparent pixel at that position, or SILBATCH_NONE
 
- *****************************************************************************/
+Remarks:
+  - Takes view, orientation, scaling, rotation and groups of the layer into account.
+  - Hidden sprites and sprites with flag SILSPRITE_NOHIT are skipped.
 
-void sil_LayersToFB(SILFB *fb) {
-  SILLYR *layer;
-  BYTE red,green,blue,alpha;
-  BYTE mixred,mixgreen,mixblue,mixalpha;
-  float af;
-  float negaf;
+*/
+UINT sil_hitBatchSprite(SILLYR *layer, UINT x, UINT y) {
+  UINT lx,ly;
 
 #ifndef SIL_LIVEDANGEROUS
-  if (0==fb->size) {
-    log_warn("Trying to merge layers to uninitialized framebuffer");
-    return;
+  if ((NULL==layer)||(NULL==layer->fb)||(NULL==layer->fb->batch)) {
+    log_warn("hittest of sprites on layer that isn't a batch layer");
+    return SILBATCH_NONE;
   }
 #endif
+  if (!layerAt(layer,x,y,&lx,&ly)) return SILBATCH_NONE;
+  return sil_spriteAtFB(layer->fb,lx,ly);
+}
 
-  layer=sil_getBottom();
-  sil_clearFB(fb);
-  while (layer) {
-    if (!(layer->flags&SILFLAG_INVISIBLE)) {
-      for (int y=layer->view.miny; y<(layer->view.miny+layer->view.height); y++) {
-        for (int x=layer->view.minx; x<(layer->view.minx+layer->view.width); x++) {
-          int absx=x+layer->relx-layer->view.minx;
-          int absy=y+layer->rely-layer->view.miny;
-          int rx=x;
-          int ry=y;
-
-          /* prevent drawing outside borders of display */
-          if ((absx>fb->width)||(absy>fb->height)) continue;
-
-          sil_getPixelLayer(layer,rx,ry,&red,&green,&blue,&alpha);
-          if (0==alpha) continue; /* nothing to do if completely transparant */
-          alpha=alpha*layer->alpha;
-          if (255==alpha) {
-            sil_putPixelFB(fb,absx,absy,red,green,blue,255);
-          } else {
-            /* lets do our own alpha blending */
-            sil_getPixelFB(fb,absx,absy,&mixred,&mixgreen,&mixblue,&mixalpha);
-            af=((float)alpha)/255;
-            negaf=1-af;
-            red=red*af+negaf*mixred;
-            green=green*af+negaf*mixgreen;
-            blue=blue*af+negaf*mixblue;
-            sil_putPixelFB(fb,absx,absy,red,green,blue,255);
-          }
-        }
+/*****************************************************************************
+
+  Internal function, used by sil_findHighestClick and sil_findHighestHover
+
+  Collects the candidates from the cell the mousepointer is in, highest layer 
+  first, and only the ones above the highest visible layer with flag 
+  MOUSESHIELD (that one included). Candidates are kept until the pointer 
+  leaves the cell or something changes (generation of index), so moving 
+  within same layer only needs a single check against that layer.
+
+ *****************************************************************************/
+static int eligible(SILLYR *layer, BYTE click) {
+  if (click) return ((NULL!=layer->click)||(layer->flags&SILFLAG_DRAGGABLE));
+  return (NULL!=layer->hover);
+}
+
+static SILLYR *findHighest(GCACHE *cache, UINT x, UINT y, BYTE click) {
+  GLIST *b;
+  SILLYR *layer;
+  UINT shield=0;
+  UINT i,j;
+  int cx,cy;
+
+  if (gv.zdirty) renumber();
+  if (gv.stalecnt) refreshGroups();
+  cx=cellOf(x);
+  cy=cellOf(y);
+
+  if ((cache->generation!=gv.generation)||(cache->cellx!=cx)||(cache->celly!=cy)) {
+    /* highest shielding layer */
+    for (i=0;i<gv.shields.cnt;i++) {
+      if (gv.shields.item[i]->idx.zpos>shield) shield=gv.shields.item[i]->idx.zpos;
+    }
+    cache->cand.cnt=0;
+    b=bucket(cx,cy);
+    for (i=0;i<b->cnt;i++) {
+      layer=b->item[i];
+      /* different cells can end up in same bucket */
+      if ((cx<layer->idx.minx)||(cx>layer->idx.maxx)||(cy<layer->idx.miny)||(cy>layer->idx.maxy)) continue;
+      if ((eligible(layer,click))&&(layer->idx.zpos>=shield)) listAdd(&cache->cand,layer);
+    }
+    for (i=0;i<gv.large.cnt;i++) {
+      layer=gv.large.item[i];
+      if ((eligible(layer,click))&&(layer->idx.zpos>=shield)) listAdd(&cache->cand,layer);
+    }
+    /* sort on stacking order, highest first */
+    for (i=1;i<cache->cand.cnt;i++) {
+      layer=cache->cand.item[i];
+      for (j=i;(j>0)&&(cache->cand.item[j-1]->idx.zpos<layer->idx.zpos);j--) {
+        cache->cand.item[j]=cache->cand.item[j-1];
       }
+      cache->cand.item[j]=layer;
     }
-    layer=layer->next;
+    cache->generation=gv.generation;
+    cache->cellx=cx;
+    cache->celly=cy;
   }
-  
-  /* clear changed flags, although they are only use by SDL platform at the moment */
-  /* but just to be sure or for further development                                */
-  layer=sil_getBottom();
-  while(layer) {
-    layer->fb->changed=0;
-    layer->fb->resized=0;
-    layer=layer->next;
+
+  for (i=0;i<cache->cand.cnt;i++) {
+    if (hitLayer(cache->cand.item[i],x,y)) return cache->cand.item[i];
   }
+  return NULL;
 }
 
 /*****************************************************************************
@@ -2053,36 +3902,7 @@ void sil_LayersToFB(SILFB *fb) {
 
  *****************************************************************************/
 SILLYR *sil_findHighestClick(UINT x,UINT y) {
-  SILLYR *layer;
-  BYTE red,green,blue,alpha;
-  int xl,xr,yt,yb;
-
-  layer=sil_getTop();
-  while (layer) {
-    if (!(layer->flags&SILFLAG_INVISIBLE)) {
-      if ((NULL!=layer->click)||(sil_checkFlags(layer,SILFLAG_DRAGGABLE))) {
-        /* calculate boundaries of layers where x,y must fall into */
-        xl=layer->relx-(int)(layer->view.minx);
-        xr=layer->relx+(int)(layer->view.width);
-        yt=layer->rely-(int)(layer->view.miny);
-        yb=layer->rely+(int)(layer->view.height);
-        if ((x>=xl) && (x<xr) && (y>=yt) && (y<yb)) {
-          /* return inmediatly when all pixels within view can be considered as target */
-          if (layer->flags&SILFLAG_MOUSEALLPIX) return layer;
-          /* otherwise, fetch pixel info and only target if pixel isn't transparant    */
-          sil_getPixelLayer(layer,x-(layer->relx)+(layer->view.minx),
-              y-(layer->rely)+(layer->view.miny),&red,&green,&blue,&alpha);
-          if (alpha>0) return layer;
-        }
-      }
-      /* if we find layer with flag "MOUSESHIELD" , we stop searching */
-      /* therefore blocking/shielding any mouseevent for layer under  */
-      /* this layer                                                   */
-      if (layer->flags&(SILFLAG_MOUSESHIELD)) return NULL;
-    }
-    layer=layer->previous;
-  }
-  return NULL;
+  return findHighest(&gv.click,x,y,1);
 }
 
 /*****************************************************************************
@@ -2104,37 +3924,7 @@ SILLYR *sil_findHighestClick(UINT x,UINT y) {
 
  *****************************************************************************/
 SILLYR *sil_findHighestHover(UINT x,UINT y) {
-  SILLYR *layer;
-  BYTE red,green,blue,alpha;
-  int xl,xr,yt,yb;
-
-  layer=sil_getTop();
-  while (layer) {
-    if (!(layer->flags&SILFLAG_INVISIBLE)) {
-      if (NULL!=layer->hover) {
-        /* calculate boundaries of layers where x,y must fall into */
-        xl=layer->relx-(int)(layer->view.minx);
-        xr=layer->relx+(int)(layer->view.width);
-        yt=layer->rely-(int)(layer->view.miny);
-        yb=layer->rely+(int)(layer->view.height);
-        if ((x>=xl) && (x<xr) && (y>=yt) && (y<yb)) {
-          /* return inmediatly when all pixels within view can be considered as target */
-          if (layer->flags&SILFLAG_MOUSEALLPIX) return layer;
-          /* otherwise, fetch pixel info and only target if pixel isn't transparant    */
-          sil_getPixelLayer(layer,x-(layer->relx)+(layer->view.minx),
-              y-(layer->rely)+(layer->view.miny),&red,&green,&blue,&alpha);
-          if (alpha>0) return layer;
-        }
-      }
-      /* if we find layer with flag "MOUSESHIELD" , we stop searching */
-      /* therefore blocking/shielding any mouseevent for layer under  */
-      /* this layer                                                   */
-
-      if (layer->flags&(SILFLAG_MOUSESHIELD)) { return NULL; }
-    }
-    layer=layer->previous;
-  }
-  return NULL;
+  return findHighest(&gv.hover,x,y,0);
 }
 
 /*****************************************************************************
@@ -2147,24 +3937,27 @@ SILLYR *sil_findHighestHover(UINT x,UINT y) {
 
  *****************************************************************************/
 SILLYR *sil_findHighestKeyPress(UINT c,BYTE modifiers) {
+  SILLYR *found=NULL;
   SILLYR *layer;
+  GLIST *list;
+  UINT i;
 
-  layer=sil_getTop();
-  while (layer) {
-    if (NULL!=layer->keypress) {
-      if ((layer->key)||(layer->modifiers)) {
-        /* layer has a keypress handler, but is it looking for this shortcut key ? */
-        if ((c==layer->key) && (modifiers==layer->modifiers)) {
-          return layer;
-        }
-      } else {
-        /* no key or modifier set, so its a "catch all" for all keyevents */
-        return layer;
-      }
-    }
-    layer=layer->previous;
+  if (gv.zdirty) renumber();
+
+  /* layers waiting for this key and modifiers (bucket can contain others) */
+  list=keyBucket(c,modifiers);
+  for (i=0;i<list->cnt;i++) {
+    layer=list->item[i];
+    if ((c!=layer->key)||(modifiers!=layer->modifiers)) continue;
+    if ((NULL==found)||(layer->idx.zpos>found->idx.zpos)) found=layer;
   }
-  return NULL;
+
+  /* "catch all" layers only win if they are higher in stack */
+  for (i=0;i<gv.catchall.cnt;i++) {
+    layer=gv.catchall.item[i];
+    if ((NULL==found)||(layer->idx.zpos>found->idx.zpos)) found=layer;
+  }
+  return found;
 }
 
 /* Group: Sprites */
@@ -2339,6 +4132,82 @@ void sil_setSprite(SILLYR *layer,UINT pos) {
 }
 /* Group: Grouping */
 
+/*****************************************************************************
+
+  Internal functions for groups, adding & removing layers and subgroups, 
+  keeping them at same position on display.
+
+ *****************************************************************************/
+
+/* offset of group on display, including groups it is part of */
+static void groupOffset(SILGROUP *group, int *x, int *y) {
+  *x=0;
+  *y=0;
+  for (;group;group=group->parent) {
+    *x+=group->relx;
+    *y+=group->rely;
+  }
+}
+
+static void unlinkLayer(SILLYR *layer) {
+  SILGROUP *group=layer->group;
+  int gx,gy;
+
+  if (NULL==group) return;
+  groupOffset(group,&gx,&gy);
+  layer->relx+=gx;
+  layer->rely+=gy;
+  if (layer->gprevious) {
+    layer->gprevious->gnext=layer->gnext;
+  } else {
+    group->layers=layer->gnext;
+  }
+  if (layer->gnext) {
+    layer->gnext->gprevious=layer->gprevious;
+  } else {
+    group->last=layer->gprevious;
+  }
+  group->count--;
+  layer->group=NULL;
+  /* for SDL, alpha of group doesn't apply anymore */
+  layer->internal|=SILFLAG_ALPHACHANGED;
+  layer->gnext=NULL;
+  layer->gprevious=NULL;
+}
+
+static void unlinkGroup(SILGROUP *group) {
+  SILGROUP *parent=group->parent;
+  int gx,gy;
+
+  if (NULL==parent) return;
+  groupOffset(parent,&gx,&gy);
+  group->relx+=gx;
+  group->rely+=gy;
+  if (group->previous) {
+    group->previous->next=group->next;
+  } else {
+    parent->first=group->next;
+  }
+  if (group->next) group->next->previous=group->previous;
+  group->parent=NULL;
+  group->next=NULL;
+  group->previous=NULL;
+}
+
+/* internal function, call given function for all layers in group and its subgroups */
+static void eachLayer(SILGROUP *group, void (*fn)(SILLYR *,UINT), UINT arg) {
+  SILLYR *layer,*next;
+  SILGROUP *sub;
+
+  for (layer=group->layers;layer;layer=next) {
+    /* function might change order within group */
+    next=layer->gnext;
+    fn(layer,arg);
+  }
+  for (sub=group->first;sub;sub=sub->next) eachLayer(sub,fn,arg);
+}
+
+
 /*
 Function: sil_createGroup
   Creates a group
@@ -2349,8 +4218,12 @@ Returns:
 Remarks: 
   - Creating groups will make it possible to do the same action, like hide,show 
     or move to all layers in the group. 
-  - Layers are not "bounded", they can still be controlled seperately 
-  - Layers can be in multiple groups. 
+  - Position of a layer in a group is relative to the group. Moving a group 
+    (<sil_moveGroup()>) will move all layers in it, without changing the layers themselves.
+  - Alpha and visibility of group are combined with those of the layers in it. A layer
+    is only visible if both the layer and its group(s) are visible.
+  - Groups can contain other groups, see <sil_addSubGroup()>
+  - A layer can only be in one group, adding it to another one removes it from the first
   - Use <sil_addLayerGroup()> to populate group
 
 */
@@ -2362,8 +4235,7 @@ SILGROUP *sil_createGroup() {
     log_warn("ERR: Can't allocate memory for createGroup");
     return NULL;
   }
-  group->layer=NULL;
-  group->next=NULL;
+  group->alpha=1;
   return group;
 }
 
@@ -2373,27 +4245,43 @@ Function: sil_addLayerGroup
   Add layer to group
 
 Parameters:
+  group - Group to add layer to
   layer - Layer to add
+
+Remarks:
+  - Layer will stay on the same position on display, its relx,rely will be changed 
+    to be relative to the group
+  - If layer is already part of another group, it will be removed from that one first
 */
 
 void sil_addLayerGroup(SILGROUP *group, SILLYR *layer) {
-  SILGROUP *new,*walk;
+  int gx,gy;
 
   if (NULL==group) {
     log_warn("adding layer to non-initialized group");
     return;
   }
-
-  new=sil_createGroup();
-  if (NULL==new) return; /* error already logged by createGroup */
-
-  walk=group;
-  while(walk->next) walk=walk->next;
-
-
-  walk->next=new;
-  new->layer=layer;
-
+  if ((NULL==layer)||(!layer->init)) {
+    log_warn("adding non-existing layer to group");
+    return;
+  }
+  if (layer->group==group) return;
+
+  unlinkLayer(layer);
+  groupOffset(group,&gx,&gy);
+  layer->relx-=gx;
+  layer->rely-=gy;
+  layer->group=group;
+  layer->gnext=NULL;
+  layer->gprevious=group->last;
+  if (group->last) {
+    group->last->gnext=layer;
+  } else {
+    group->layers=layer;
+  }
+  group->last=layer;
+  group->count++;
+  sil_updateIndex(layer);
 }
 
 /*
@@ -2405,14 +4293,10 @@ Parameters:
   layer - Layer to remove
 
 Remarks:
-  - Will ignore removing of layer if it isn't in given group
-  - You can add same layer multiple times to same group, however, this 
-    function will only remove first appearance.
+  - Will ignore removing of layer if it isn't in given group (subgroups not included)
+  - Layer stays on the same position on display
 */
 void sil_removeLayerGroup(SILGROUP *group, SILLYR *layer) {
-  SILGROUP *found;
-  SILGROUP *previous=NULL;
-
   if (NULL==group) {
     log_warn("removing layer from non-initialized group");
     return;
@@ -2423,18 +4307,73 @@ void sil_removeLayerGroup(SILGROUP *group, SILLYR *layer) {
     return;
   }
  
-  found=group;
-  while((found->layer!=layer)&&(found->next)) {
-    previous=found;
-    found=found->next;
+  if (layer->group!=group) return;
+  unlinkLayer(layer);
+  sil_updateIndex(layer);
+}
+
+
+/*
+Function: sil_addSubGroup
+  Make group part of another group
+
+Parameters:
+  group - Group to add to
+  sub   - Group to add 
+
+Remarks:
+  - Position of sub group will be relative to given group, but layers in it will
+    stay on same position of display
+  - If sub is already part of another group, it will be removed from that one first
+  - Adding a group to itself, or one of its own subgroups, is ignored
+*/
+void sil_addSubGroup(SILGROUP *group, SILGROUP *sub) {
+  SILGROUP *walk;
+  int gx,gy;
+
+  if ((NULL==group)||(NULL==sub)) {
+    log_warn("adding non-initialized group to group");
+    return;
   }
-  if (found->layer==layer) {
-    if (previous) previous->next=found->next;
-    if (found) free(found);
+  if (sub->parent==group) return;
+  for (walk=group;walk;walk=walk->parent) {
+    if (walk==sub) {
+      log_warn("can't add group to itself or one of its subgroups");
+      return;
+    }
   }
 
+  unlinkGroup(sub);
+  groupOffset(group,&gx,&gy);
+  sub->relx-=gx;
+  sub->rely-=gy;
+  sub->parent=group;
+  sub->previous=NULL;
+  sub->next=group->first;
+  if (group->first) group->first->previous=sub;
+  group->first=sub;
+  markStale(sub);
 }
 
+/*
+Function: sil_removeSubGroup
+  Remove group from the group it is part of
+
+Parameters:
+  sub - Group to remove from its parent
+
+Remarks:
+  - Layers in group will stay on the same position on display
+*/
+void sil_removeSubGroup(SILGROUP *sub) {
+  if (NULL==sub) {
+    log_warn("removing non-initialized group from group");
+    return;
+  }
+  if (NULL==sub->parent) return;
+  unlinkGroup(sub);
+  markStale(sub);
+}
 
 
 /*
@@ -2443,59 +4382,66 @@ Function: sil_destroyGroup
 
 Parameters:
   group - Group to remove
+
+Remarks:
+  - Layers and subgroups in the group will not be destroyed, but will be removed
+    from it, keeping them on the same position on display.
 */
 void sil_destroyGroup(SILGROUP *group) {
-  SILGROUP *next;
+  SILLYR *layer;
 
   if (NULL==group) return;
-  do {
-    next=group->next;
-    free(group);
-    group=next;
-  } while(next);
+  while (group->first) sil_removeSubGroup(group->first);
+  while (group->layers) {
+    layer=group->layers;
+    unlinkLayer(layer);
+    sil_updateIndex(layer);
+  }
+  unlinkGroup(group);
+
+  /* don't leave it behind in list of stale groups */
+  if (group->stale) {
+    for (UINT i=0;i<gv.stalecnt;i++) {
+      if (gv.stale[i]==group) gv.stale[i]=gv.stale[--gv.stalecnt];
+    }
+  }
+  free(group);
 }
 
 
 /*
 Function: sil_showGroup
-  calls <sil_show()> for all layers in group
+  Show group, and so all layers in it that aren't hidden themselves
 
 Parameters:
   group - Group to use
 */
 void sil_showGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_show(walk->layer);
-    walk=walk->next;
-  }
+  if (!(group->flags&SILFLAG_INVISIBLE)) return;
+  group->flags&=~SILFLAG_INVISIBLE;
+  markStale(group);
 }
 
 
 /*
 Function: sil_hideGroup
-  calls <sil_hide()> for all layers in group
+  Hide group and so all layers in it, without changing visibility of the layers 
+  themselves
 
 Parameters:
   group - Group to use
 */
 void sil_hideGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_hide(walk->layer);
-    walk=walk->next;
-  }
+  if (group->flags&SILFLAG_INVISIBLE) return;
+  group->flags|=SILFLAG_INVISIBLE;
+  markStale(group);
 }
 
 /*
 Function: sil_moveGroup
-  calls <sil_moveLayer()> for all layers in group
+  moves group, and so all layers in it
 
 Parameters:
   group - Group to use
@@ -2504,147 +4450,172 @@ Parameters:
 
 */
 void sil_moveGroup(SILGROUP *group,int x, int y) {
-  SILGROUP *walk;
+  if (NULL==group) return;
+  group->relx+=x;
+  group->rely+=y;
+  markStale(group);
+}
+
+/*
+Function: sil_placeGroup
+  place group at given position, relative to the group it is part of or the display
+
+Parameters:
+  group - Group to use
+  x     - x position
+  y     - y position
 
+Remarks:
+  - A new group starts at 0,0, so position is the offset added to the positions of 
+    the layers that were added to it.
+*/
+void sil_placeGroup(SILGROUP *group,int x, int y) {
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_moveLayer(walk->layer,x,y);
-    walk=walk->next;
-  }
+  group->relx=x;
+  group->rely=y;
+  markStale(group);
+}
+
+/*
+Function: sil_setAlphaGroup
+  set alpha of group, this will be combined with alpha of layers (and groups) in it
+
+Parameters:
+  group - Group to use
+  alpha - alpha value from 0 (transparent) till 1 (not transparent)
+*/
+void sil_setAlphaGroup(SILGROUP *group,float alpha) {
+  if (NULL==group) return;
+  if (alpha<0) alpha=0;
+  if (alpha>1) alpha=1;
+  group->alpha=alpha;
+}
+
+
+static void nextSprite(SILLYR *layer, UINT arg) {
+  (void)arg;
+  sil_nextSprite(layer);
+}
+
+static void prevSprite(SILLYR *layer, UINT arg) {
+  (void)arg;
+  sil_prevSprite(layer);
+}
+
+static void setSprite(SILLYR *layer, UINT arg) {
+  sil_setSprite(layer,arg);
+}
+
+static void resetView(SILLYR *layer, UINT arg) {
+  (void)arg;
+  sil_resetView(layer);
+}
+
+static void toTop(SILLYR *layer, UINT arg) {
+  (void)arg;
+  sil_toTop(layer);
 }
 
+static void toBottom(SILLYR *layer, UINT arg) {
+  (void)arg;
+  sil_toBottom(layer);
+}
 
 /*
 Function: sil_nextSpriteGroup
-  calls <sil_nextSprite()> for all layers in group
+  calls <sil_nextSprite()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
 */
 void sil_nextSpriteGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_nextSprite(walk->layer);
-    walk=walk->next;
-  }
+  eachLayer(group,nextSprite,0);
 }
 
 /*
 Function: sil_prevSpriteGroup
-  calls <sil_prevSprite()> for all layers in group
+  calls <sil_prevSprite()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
 */
 void sil_prevSpriteGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_prevSprite(walk->layer);
-    walk=walk->next;
-  }
+  eachLayer(group,prevSprite,0);
 }
 
 /*
 Function: sil_setSpriteGroup
-  calls <sil_setSprite()> for all layers in group
+  calls <sil_setSprite()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
   num   - number of spirt
 */
 void sil_setSpriteGroup(SILGROUP *group,UINT num) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_setSprite(walk->layer,num);
-    walk=walk->next;
-  }
+  eachLayer(group,setSprite,num);
 }
 
 /*
 Function: sil_checkLayerGroup
-  Checks for all occurrences of layer in group
+  Checks if layer is part of group, directly or via one of its subgroups 
 
 Parameters:
   group - Group to use
   layer - Layer to check
 
 Returns:
-  amount of occurrences of layer in this group
+  1 if layer is in this group, 0 if not
+
+Remarks:
+  - Only follows the parents of the group the layer is in, so it costs one 
+    step per level of nesting, not per layer in the group.
 */
 UINT sil_checkLayerGroup(SILGROUP *group,SILLYR *layer) {
   SILGROUP *walk;
-  UINT cnt=0;
 
-  if (NULL==group) return 0;
-  walk=group;
-  while(walk) {
-    if ((walk->layer) && (walk->layer==layer)) cnt++;
-    walk=walk->next;
+  if ((NULL==group)||(NULL==layer)) return 0;
+  for (walk=layer->group;walk;walk=walk->parent) {
+    if (walk==group) return 1;
   }
-  return cnt;
+  return 0;
 }
 
 /*
 Function: sil_resetViewGroup
-  calls <sil_resetView()> for all layers in group
+  calls <sil_resetView()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
 */
 void sil_resetViewGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_resetView(walk->layer);
-    walk=walk->next;
-  }
+  eachLayer(group,resetView,0);
 }
 
 
 /*
 Function: sil_topGroup
-  calls <sil_toTop()> for all layers in group
+  calls <sil_toTop()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
 */
 void sil_topGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_toTop(walk->layer);
-    walk=walk->next;
-  }
+  eachLayer(group,toTop,0);
 }
 
 /*
 Function: sil_bottomGroup
-  calls <sil_toBottom()> for all layers in group
+  calls <sil_toBottom()> for all layers in group and its subgroups
 
 Parameters:
   group - Group to use
 */
 void sil_bottomGroup(SILGROUP *group) {
-  SILGROUP *walk;
-
   if (NULL==group) return;
-  walk=group;
-  while(walk) {
-    if (walk->layer) sil_toBottom(walk->layer);
-    walk=walk->next;
-  }
+  eachLayer(group,toBottom,0);
 }
@@ -24,6 +24,7 @@
 */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -53,8 +54,14 @@ typedef struct _GDISP {
   UINT lastx;
   UINT lasty;
   BYTE button;
+  BYTE rotation;
+  UINT rawx;
+  UINT rawy;
 } GDISP;
 
+/* size of square blocks (in pixels) used when transposing to rotated display */
+#define SILFB_BLOCK 16
+
 static GDISP gv;
 
 BYTE sil_getMouse(int *x,int *y) {
@@ -210,11 +217,197 @@ UINT sil_initDisplay(void *hI, UINT width, UINT height, char *title) {
   /* init some global variables for later */
   gv.lastx=0;
   gv.lasty=0;
+  gv.rawx=0;
+  gv.rawy=0;
   gv.button=0;
+  gv.rotation=SILROT_NONE;
+
+  return SILERR_ALLOK;
+}
+
+/*****************************************************************************
+  
+  Set rotation of display, for displays that are mounted sideways or upside
+  down. SIL will use a framebuffer with the logical (rotated) dimensions and
+  rotates it when copying to the real framebuffer. Touch coordinates are 
+  rotated back, so layers and handlers only see logical coordinates.
+
+  rotation: SILROT_NONE, SILROT_90, SILROT_180 or SILROT_270 (counterclockwise)
+
+  Only works for displays with a whole amount of bytes per pixel, so not for
+  444 types (1.5 bytes per pixel).
+
+ *****************************************************************************/
+UINT sil_setRotationDisplay(BYTE rotation) {
+  SILFB *fb;
+  UINT width,height;
+
+#ifndef SIL_LIVEDANGEROUS
+  if (NULL==gv.fb) {
+    log_warn("trying to rotate non-initialized display");
+    return SILERR_NOTINIT;
+  }
+  if (rotation>SILROT_270) {
+    log_warn("unknown display rotation %d",rotation);
+    return SILERR_WRONGFORMAT;
+  }
+  if ((SILROT_NONE!=rotation)&&(gv.vinfo.bits_per_pixel%8)) {
+    log_warn("Can't rotate display with %d bits per pixel",gv.vinfo.bits_per_pixel);
+    return SILERR_WRONGFORMAT;
+  }
+#endif
+
+  if ((SILROT_90==rotation)||(SILROT_270==rotation)) {
+    width=gv.vinfo.yres;
+    height=gv.vinfo.xres;
+  } else {
+    width=gv.vinfo.xres;
+    height=gv.vinfo.yres;
+  }
 
+  /* only need new framebuffer when dimensions change */
+  if ((width!=gv.fb->width)||(height!=gv.fb->height)) {
+    fb=sil_initFB(width,height,gv.fb->type);
+    if (NULL==fb) {
+      log_warn("Can't create framebuffer for rotated display");
+      return SILERR_NOMEM;
+    }
+    sil_destroyFB(gv.fb);
+    gv.fb=fb;
+  }
+  gv.rotation=rotation;
+  gv.lastx=0;
+  gv.lasty=0;
   return SILERR_ALLOK;
 }
 
+BYTE sil_getRotationDisplay() {
+  return gv.rotation;
+}
+
+/* copy single pixel of bpp bytes */
+static inline void copyPixel(BYTE *dst, BYTE *src, UINT bpp) {
+  switch (bpp) {
+    case 4: *(uint32_t *)dst=*(uint32_t *)src; break;
+    case 2: *(uint16_t *)dst=*(uint16_t *)src; break;
+    case 3: dst[2]=src[2]; /* fall through */
+            dst[1]=src[1]; /* fall through */
+    case 1: dst[0]=src[0]; break;
+  }
+}
+
+/*****************************************************************************
+  
+  Copy logical framebuffer to (rotated) display. For 90 and 270 degrees, this
+  is a transpose; reading columns of the source will trash the cache, so it 
+  is done in square blocks that fit in cache, writing rows of the display 
+  while reading a small amount of source rows.
+
+  Mapping logical (x,y) on logical framebuffer of WxH to display (px,py):
+  SILROT_90  : px=y      , py=W-1-x
+  SILROT_180 : px=W-1-x  , py=H-1-y
+  SILROT_270 : px=H-1-y  , py=x
+
+ *****************************************************************************/
+static void blitDisplay() {
+  UINT bpp=gv.vinfo.bits_per_pixel/8;
+  UINT stride=gv.finfo.line_length;
+  UINT w=gv.fb->width;
+  UINT h=gv.fb->height;
+  UINT sstride=gv.fb->size/h;
+  UINT bx,by,px,py,pxe,pye,x,y;
+  BYTE *src;
+  BYTE *dst;
+
+  switch (gv.rotation) {
+    case SILROT_180:
+      for (y=0;y<h;y++) {
+        src=gv.fb->buf+y*sstride;
+        dst=gv.fbp+(h-1-y)*stride+(w-1)*bpp;
+        for (x=0;x<w;x++) {
+          copyPixel(dst,src,bpp);
+          src+=bpp;
+          dst-=bpp;
+        }
+      }
+      break;
+
+    case SILROT_90:
+    case SILROT_270:
+      /* display is h pixels wide and w pixels high */
+      for (by=0;by<w;by+=SILFB_BLOCK) {
+        pye=SIL_MIN(by+SILFB_BLOCK,w);
+        for (bx=0;bx<h;bx+=SILFB_BLOCK) {
+          pxe=SIL_MIN(bx+SILFB_BLOCK,h);
+          for (py=by;py<pye;py++) {
+            dst=gv.fbp+py*stride+bx*bpp;
+            if (SILROT_90==gv.rotation) {
+              /* x=W-1-py, y=px */
+              src=gv.fb->buf+bx*sstride+(w-1-py)*bpp;
+              for (px=bx;px<pxe;px++) {
+                copyPixel(dst,src,bpp);
+                dst+=bpp;
+                src+=sstride;
+              }
+            } else {
+              /* x=py, y=H-1-px */
+              src=gv.fb->buf+(h-1-bx)*sstride+py*bpp;
+              for (px=bx;px<pxe;px++) {
+                copyPixel(dst,src,bpp);
+                dst+=bpp;
+                src-=sstride;
+              }
+            }
+          }
+        }
+      }
+      break;
+
+    default:
+      /* line_length can be larger then visible width */
+      if (stride==sstride) {
+        memcpy(gv.fbp,gv.fb->buf,gv.fb->size);
+      } else {
+        for (y=0;y<h;y++) {
+          memcpy(gv.fbp+y*stride,gv.fb->buf+y*sstride,SIL_MIN(sstride,stride));
+        }
+      }
+      break;
+  }
+}
+
+/* rotate raw touchscreen coordinates back to logical display coordinates */
+static void rawToLogical(UINT rx, UINT ry, UINT *x, UINT *y) {
+  UINT w=gv.fb->width;
+  UINT h=gv.fb->height;
+
+  switch (gv.rotation) {
+    case SILROT_90:
+      ry=SIL_MIN(ry,w-1);
+      *x=w-1-ry;
+      *y=rx;
+      break;
+    case SILROT_180:
+      rx=SIL_MIN(rx,w-1);
+      ry=SIL_MIN(ry,h-1);
+      *x=w-1-rx;
+      *y=h-1-ry;
+      break;
+    case SILROT_270:
+      rx=SIL_MIN(rx,h-1);
+      *x=ry;
+      *y=h-1-rx;
+      break;
+    default:
+      *x=rx;
+      *y=ry;
+      break;
+  }
+  /* raw values outside of range shouldn't end up outside the display */
+  if (*x>=w) *x=w-1;
+  if (*y>=h) *y=h-1;
+}
+
 /*****************************************************************************
   
   Update Display
@@ -225,8 +418,8 @@ void sil_updateDisplay() {
   /* get all layerinformation into a single fb */
   sil_LayersToFB(gv.fb);
 
-  /* and just copy it */
-  memcpy(gv.fbp,gv.fb->buf,gv.screensize);
+  /* and copy it, rotating if needed */
+  blitDisplay();
 
 }
 
@@ -281,6 +474,7 @@ SILEVENT *sil_getEventDisplay() {
   struct timeval tt,tv;
   struct input_event ev;
   int rd=0;
+  UINT x,y;
 
 
   do {
@@ -339,22 +533,28 @@ SILEVENT *sil_getEventDisplay() {
           /* wait for other events for more information */
         }
 
+        /* coordinates are from the touchscreen, so not rotated */
         if (EV_ABS==ev.type) {
           if (ABS_X==ev.code) {
-            gv.se.x=ev.value;
-            gv.se.dx=ev.value-gv.lastx;
-            gv.lastx=ev.value;
+            gv.rawx=ev.value;
           } else {
             if (ABS_Y==ev.code) {
-              gv.se.y=ev.value;
-              gv.se.dy=ev.value-gv.lasty;
-              gv.lasty=ev.value;
+              gv.rawy=ev.value;
             }
           }
           if (SILDISP_NOTHING==gv.se.type) gv.se.type=SILDISP_MOUSE_MOVE;
         }
 
       } while (!((EV_SYN==ev.type)&&(SYN_REPORT==ev.code))); 
+
+      /* translate to logical coordinates of (rotated) display */
+      rawToLogical(gv.rawx,gv.rawy,&x,&y);
+      gv.se.x=x;
+      gv.se.y=y;
+      gv.se.dx=(int)x-(int)gv.lastx;
+      gv.se.dy=(int)y-(int)gv.lasty;
+      gv.lastx=x;
+      gv.lasty=y;
       if (SILDISP_NOTHING!=gv.se.type) stop=1;
     }
   } while (!stop);
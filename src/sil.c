@@ -157,8 +157,7 @@ static void checkMove(SILEVENT *se) {
       se->layer=al;
       if (al->drag(se)) {
         /* if returns > 0, it will process proposed move */
-        al->relx=se->x;
-        al->rely=se->y;
+        sil_placeLayer(al,se->x,se->y);
         sil_updateDisplay();
       }
       return;
@@ -185,7 +184,7 @@ static void checkMove(SILEVENT *se) {
     if ((al)&&(al->hover)) {
       se->layer=al;
       se->type=SILDISP_MOUSE_LEFT;
-      if (!sil_checkFlags(al,SILFLAG_INVISIBLE)) {
+      if (sil_resolveLayer(al,NULL,NULL,NULL)) {
         if (al->hover(se)) sil_updateDisplay();
       }
     }
@@ -205,7 +204,7 @@ static void checkMove(SILEVENT *se) {
       tmp=se->layer;
       se->layer=al;
       se->type=SILDISP_MOUSE_LEFT;
-      if (!sil_checkFlags(al,SILFLAG_INVISIBLE)) {
+      if (sil_resolveLayer(al,NULL,NULL,NULL)) {
         if (al->hover(se)) sil_updateDisplay();
       }
       se->layer=tmp;
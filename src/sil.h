@@ -1,6 +1,8 @@
 #ifndef SIL_H
 #define SIL_H
 
+#include <stdint.h>
+
 /* tired of typing "unsigned" everywhere .... */
 #define BYTE unsigned char
 #define UINT unsigned int
@@ -75,10 +77,18 @@ UINT sil_getTimeval();
   SILTYPE_ABGR   - 4   Bytes RRRRRRRR GGGGGGGG BBBBBBBB AAAAAAAA
   SILTYPE_ARGB   - 4   Bytes BBBBBBBB GGGGGGGG RRRRRRRR AAAAAAAA
   SILTYPE_EMPTY  - 0   Bytes (ignores all pixel operations)
+  SILTYPE_4444ARGB - 2 Bytes GGGGBBBB AAAARRRR
+  SILTYPE_1555ARGB - 2 Bytes GGGBBBBB ARRRRRGG
 
   Remarks: 
-    Picking a type other then ABGR or ARGB means also you can't do anything 
-    to make it transparent, since there will be no alpha information stored
+    Picking a type other then ABGR, ARGB, 4444ARGB or 1555ARGB means also you 
+    can't do anything to make it transparent, since there will be no alpha 
+    information stored (but see <sil_setColorKey()>)
+
+    4444ARGB and 1555ARGB are the 16 bit types with alpha, at half the memory 
+    of ARGB. 4444ARGB has 16 levels of transparency, which is good enough for 
+    most icons and UI art, 1555ARGB only has fully transparent or opaque pixels 
+    but more colors.
     
     The easiest way to choose the right format is to adapt to
 
@@ -104,24 +114,63 @@ UINT sil_getTimeval();
 #define SILTYPE_ABGR     13
 #define SILTYPE_ARGB     14
 #define SILTYPE_EMPTY    15
+#define SILTYPE_4444ARGB 16
+#define SILTYPE_1555ARGB 17
+
+typedef struct _SILBOX {
+  UINT minx;
+  UINT miny;
+  UINT width;
+  UINT height;
+} SILBOX;
 
 typedef struct _SILFB {
   BYTE *buf;
   UINT width;
   UINT height;
   BYTE type;
-  UINT size;
+  uint64_t size;          /* (virtual) size of buffer in bytes      */
   BYTE changed;
   BYTE resized;
+  UINT version;           /* incremented on every change of pixels  */
+  struct _SILMASK *mask;  /* optional 1bpp hitmask, see framebuffer.c */
+  UINT originx;           /* origin when used as ringbuffer, see    */
+  UINT originy;           /* sil_scrollLayer in layer.c             */
+  struct _SILTILES *tiles;/* if set, pixels are in tiles, buf=NULL  */
+  struct _SILMAP *map;    /* if set, pixels come from tileset, buf=NULL */
+  struct _SILBATCH *batch;/* if set, pixels come from sprites, buf=NULL */
+  struct _SILSLICE *slice;/* if set, pixels come from nine-slice, buf=NULL */
+  SILBOX damage;          /* part that changed, if "changed" isn't set  */
+  SILBOX shown;           /* part of tiled buffer in display copy (SDL) */
+  BYTE colorkey;          /* if set, pixels with key color are transparent */
+  BYTE keyred;
+  BYTE keygreen;
+  BYTE keyblue;
 } SILFB;
 
 
 SILFB *sil_initFB(UINT,UINT,BYTE) ;
+SILFB *sil_initTiledFB(UINT,UINT,BYTE) ;
+SILFB *sil_initMapFB(SILFB *,UINT,UINT,UINT,UINT) ;
+SILFB *sil_initBatchFB(SILFB *,UINT,UINT,UINT,UINT) ;
+SILFB *sil_initSliceFB(SILFB *,UINT,UINT,UINT,UINT,UINT,UINT,BYTE) ;
 void sil_putPixelFB(SILFB *,UINT,UINT,BYTE,BYTE,BYTE,BYTE);
 void sil_getPixelFB(SILFB *,UINT,UINT,BYTE *,BYTE *,BYTE *,BYTE *);
 void sil_clearFB(SILFB *);
 void sil_destroyFB(SILFB *);
 
+/* tile index of an empty cell within a tilemap */
+#define SILMAP_NONE 0xFFFFFFFF
+
+/* sprites within a batch */
+#define SILBATCH_NONE    0xFFFFFFFF
+#define SILSPRITE_HIDDEN 1
+#define SILSPRITE_NOHIT  2
+
+/* how edges and center of nine-slice are filled */
+#define SILSLICE_STRETCH 0
+#define SILSLICE_TILE    1
+
 
 /* layer.c */
 
@@ -132,6 +181,7 @@ void sil_destroyFB(SILFB *);
 
 #define SILFLAG_INVISIBLE      1
 #define SILFLAG_NOBLEND        2
+#define SILFLAG_SMOOTH         4
 #define SILFLAG_DRAGGABLE      8
 #define SILFLAG_VIEWPOSSTAY   16
 #define SILFLAG_FREEUSER      32
@@ -144,6 +194,8 @@ void sil_destroyFB(SILFB *);
 #define SILKT_SINGLE           4
 #define SILKT_ONLYUP           8
 #define SILFLAG_INSTANCIATED  16
+#define SILFLAG_INDEXED       64
+#define SILFLAG_SHIELDED     128
 
 /* also used by display.c */
 typedef struct _SILEVENT {
@@ -160,12 +212,22 @@ typedef struct _SILEVENT {
 } SILEVENT;
 
 
-typedef struct _SILBOX {
-  UINT minx;
-  UINT miny;
-  UINT width;
-  UINT height;
-} SILBOX;
+typedef struct _SILXFORM {
+  float scalex;
+  float scaley;
+  float angle;
+  float cosa;
+  float sina;
+} SILXFORM;
+
+/* position of layer in spatial index for mouse handlers */
+typedef struct _SILIDX {
+  int minx;
+  int miny;
+  int maxx;
+  int maxy;
+  UINT zpos;
+} SILIDX;
 
 typedef struct _SILSPRITE {
   UINT width;
@@ -173,17 +235,38 @@ typedef struct _SILSPRITE {
   UINT pos;
 } SILSPRITE;
 
+/* groups of layers (and other groups), see layer.c */
+typedef struct _SILGROUP {
+  struct _SILGROUP *parent;   /* group this one is part of, or NULL             */
+  struct _SILGROUP *first;    /* first subgroup                                 */
+  struct _SILGROUP *next;     /* next & previous subgroup of parent             */
+  struct _SILGROUP *previous;
+  struct _SILLYR *layers;     /* first & last layer directly in group           */
+  struct _SILLYR *last;
+  UINT count;                 /* amount of layers directly in group             */
+  int relx;                   /* offset relative to parent group (or display)   */
+  int rely;
+  float alpha;
+  BYTE flags;                 /* only SILFLAG_INVISIBLE is used                 */
+  BYTE stale;                 /* moved or shown/hidden, layers must be reindexed */
+} SILGROUP;
+
 typedef struct _SILLYR {
+  /* fields needed for compositing first, keeping them in the same cacheline */
   SILFB *fb;
-  struct _SILLYR *previous;
-  struct _SILLYR *next;
   SILBOX view;
+  int relx;
+  int rely;
+  float alpha;
   BYTE init;
   BYTE flags;
   BYTE internal;
-  float alpha;
-  int relx;
-  int rely;
+  BYTE orient;
+  struct _SILLYR *previous;
+  struct _SILLYR *next;
+  SILXFORM xform;
+  /* fields only used for events, sprites and backends */
+  SILIDX idx;
   UINT id;
   void *texture;
   UINT (*hover   )(SILEVENT *);
@@ -194,14 +277,12 @@ typedef struct _SILLYR {
   UINT key;
   BYTE modifiers;
   SILSPRITE sprite;
+  SILGROUP *group;            /* group layer is part of, relx,rely are relative to it */
+  struct _SILLYR *gnext;      /* next & previous layer within that group              */
+  struct _SILLYR *gprevious;
   void *user;
 } SILLYR;
 
-typedef struct _SILGROUP {
-  SILLYR *layer;
-  struct _SILGROUP *next;
-} SILGROUP;
-
 /* this one is in sil.c, not layer.c but needs SILEVENT defined */
 void sil_setTimerHandler(UINT (*)(SILEVENT *));
 
@@ -212,6 +293,7 @@ void sil_blendPixelLayer(SILLYR *, UINT, UINT, BYTE, BYTE, BYTE, BYTE);
 void sil_getPixelLayer(SILLYR *, UINT, UINT, BYTE *, BYTE *, BYTE *, BYTE *);
 SILLYR *sil_getBottom();
 SILLYR *sil_getTop();
+SILLYR *sil_getLayerById(UINT);
 void sil_destroyLayer(SILLYR *);
 void sil_setFlags(SILLYR *,BYTE);
 void sil_clearFlags(SILLYR *,BYTE);
@@ -224,13 +306,22 @@ UINT sil_rotate90(SILLYR *);
 UINT sil_rotate180(SILLYR *);
 UINT sil_rotate270(SILLYR *);
 UINT sil_rotateLayer(SILLYR *, double);
+void sil_setScaleLayer(SILLYR *, float, float);
+void sil_setAngleLayer(SILLYR *, double);
+void sil_resetTransformLayer(SILLYR *);
 void sil_moveLayer(SILLYR *,int, int);
 void sil_placeLayer(SILLYR *,int, int);
 SILLYR *sil_PNGtoNewLayer(char *,UINT,UINT);
+SILLYR *sil_PNGtoNewLayerType(char *,UINT,UINT,BYTE);
 void sil_setKeyHandler(SILLYR *,UINT, BYTE, BYTE, UINT (*)(SILEVENT *));
 void sil_setClickHandler(SILLYR *,UINT (*)(SILEVENT *));
 void sil_setHoverHandler(SILLYR *,UINT (*)(SILEVENT *));
 void sil_setDragHandler(SILLYR *,UINT (*)(SILEVENT *));
+void sil_setHitMask(SILLYR *,BYTE);
+void sil_setHitMaskKey(SILLYR *,BYTE,BYTE,BYTE);
+void sil_clearHitMask(SILLYR *);
+void sil_setColorKey(SILLYR *, BYTE, BYTE, BYTE);
+void sil_clearColorKey(SILLYR *);
 void sil_initSpriteSheet(SILLYR *,UINT ,UINT);
 void sil_nextSprite(SILLYR *);
 void sil_prevSprite(SILLYR *);
@@ -243,9 +334,26 @@ void sil_swap(SILLYR *,SILLYR *);
 void sil_hide(SILLYR *);
 void sil_show(SILLYR *);
 SILLYR *sil_addCopy(SILLYR *,int,int);
+SILLYR *sil_addTiledLayer(int, int, UINT, UINT, BYTE, UINT (*)(SILLYR *, SILFB *, UINT, UINT));
+SILLYR *sil_addTileMapLayer(int, int, SILLYR *, UINT, UINT, UINT, UINT);
+void sil_setTileMap(SILLYR *, UINT, UINT, UINT);
+UINT sil_getTileMap(SILLYR *, UINT, UINT);
+void sil_fillTileMap(SILLYR *, UINT);
+void sil_repeatTileMap(SILLYR *, UINT, UINT);
+UINT sil_hitTileMap(SILLYR *, UINT, UINT, UINT *, UINT *);
+SILLYR *sil_addBatchLayer(int, int, UINT, UINT, SILLYR *);
+UINT sil_addBatchSprite(SILLYR *, int, int, UINT);
+void sil_setBatchSprite(SILLYR *, UINT, int, int, UINT, BYTE);
+UINT sil_getBatchSprite(SILLYR *, UINT, int *, int *, UINT *, BYTE *);
+void sil_flagBatchSprite(SILLYR *, UINT, BYTE);
+void sil_removeBatchSprite(SILLYR *, UINT);
+UINT sil_hitBatchSprite(SILLYR *, UINT, UINT);
+SILLYR *sil_addNineSliceLayer(int, int, UINT, UINT, SILLYR *, UINT, UINT, UINT, UINT, BYTE);
+void sil_resizeNineSlice(SILLYR *, UINT, UINT);
 SILLYR *sil_addInstance(SILLYR *,int,int);
 void sil_clearLayer(SILLYR *);
 void sil_shiftLayer(SILLYR *,int,int);
+void sil_scrollLayer(SILLYR *,int,int);
 
 
 SILGROUP *sil_createGroup();
@@ -256,6 +364,10 @@ void sil_destroyGroup(SILGROUP *);
 void sil_hideGroup(SILGROUP *);
 void sil_showGroup(SILGROUP *);
 void sil_moveGroup(SILGROUP *,int,int);
+void sil_placeGroup(SILGROUP *,int,int);
+void sil_setAlphaGroup(SILGROUP *,float);
+void sil_addSubGroup(SILGROUP *,SILGROUP *);
+void sil_removeSubGroup(SILGROUP *);
 void sil_nextSpriteGroup(SILGROUP *);
 void sil_prevSpriteGroup(SILGROUP *);
 void sil_setSpriteGroup(SILGROUP *,UINT);
@@ -359,6 +471,38 @@ UINT sil_grayFilter(SILLYR *);
 #define SILLO_MAJOR             1
 #define SILLO_MINOR             2
 
+/* fill rules for polygons and paths */
+#define SILFILL_NONZERO         0
+#define SILFILL_EVENODD         1
+
+typedef struct _SILPOINT {
+  float x;
+  float y;
+} SILPOINT;
+
+/* recorded drawing commands, see sil_startDisplayList */
+typedef struct _SILDLIST {
+  struct _SILDCMD *cmds;
+  UINT cnt;
+  UINT size;
+  BYTE err;
+} SILDLIST;
+
+/* joins between segments of polylines */
+#define SILJOIN_MITER           0
+#define SILJOIN_ROUND           1
+#define SILJOIN_BEVEL           2
+
+/* caps at ends of polylines */
+#define SILCAP_BUTT             0
+#define SILCAP_ROUND            1
+#define SILCAP_SQUARE           2
+
+/* filters used by sil_rescale */
+#define SILRESCALE_NEAREST      0
+#define SILRESCALE_BILINEAR     1
+#define SILRESCALE_AREA         2
+#define SILRESCALE_LANCZOS      3
 
 void sil_initDraw();
 UINT sil_PNGintoLayer(SILLYR *,char *, UINT,UINT);
@@ -374,12 +518,38 @@ void sil_drawLine(SILLYR *, UINT, UINT, UINT, UINT);
 void sil_drawLineAA(SILLYR *, UINT, UINT, UINT, UINT);
 void sil_drawCircle(SILLYR *, UINT, UINT, UINT);
 void sil_drawCircleAA(SILLYR *, UINT, UINT, UINT);
+void sil_drawEllipseAA(SILLYR *, UINT, UINT, UINT, UINT);
+UINT sil_drawArcAA(SILLYR *, UINT, UINT, UINT, UINT, UINT);
+UINT sil_drawPieAA(SILLYR *, UINT, UINT, UINT, UINT, UINT);
 void sil_drawRectangle(SILLYR *, UINT, UINT, UINT, UINT);
+void sil_drawRoundedRect(SILLYR *, UINT, UINT, UINT, UINT, UINT);
+UINT sil_floodFill(SILLYR *, UINT, UINT, BYTE);
+UINT sil_fillPolygon(SILLYR *, SILPOINT *, UINT, BYTE);
+UINT sil_fillPath(SILLYR *, SILPOINT *, UINT *, UINT, BYTE);
+UINT sil_drawPolyline(SILLYR *, SILPOINT *, UINT);
 void sil_drawPixel(SILLYR *, UINT, UINT);
 void sil_blendPixel(SILLYR *, UINT, UINT);
 void sil_setDrawWidth(UINT);
 UINT sil_getDrawWidth();
+void sil_setLineJoin(BYTE);
+BYTE sil_getLineJoin();
+void sil_setLineCap(BYTE);
+BYTE sil_getLineCap();
+UINT sil_pushClip(UINT, UINT, UINT, UINT);
+void sil_popClip();
+void sil_setLinearGradient(float, float, float, float);
+void sil_setRadialGradient(float, float, float);
+UINT sil_addGradientStop(float, BYTE, BYTE, BYTE, BYTE);
+void sil_clearGradient();
 void sil_rescale(SILLYR *, UINT,UINT);
+void sil_setRescaleFilter(BYTE);
+BYTE sil_getRescaleFilter();
+SILDLIST *sil_createDisplayList();
+void sil_clearDisplayList(SILDLIST *);
+void sil_destroyDisplayList(SILDLIST *);
+UINT sil_startDisplayList(SILDLIST *);
+UINT sil_stopDisplayList();
+UINT sil_drawDisplayList(SILLYR *, SILDLIST *, SILBOX *);
 
 /* x11display.c  / winSDLdisplay.c / winGDIdisplay.c / lnxdisplay.c */
 
@@ -432,6 +602,22 @@ void sil_getWindowSize(int *, int *);
 BYTE sil_getMouse(int *,int *);
 BYTE sil_outsideWindow();
 void sil_setSysHandler(void (*)(SILEVENT *));
+UINT sil_setRotationDisplay(BYTE);
+BYTE sil_getRotationDisplay();
+
+/* Group: Rotation 
+Counterclockwise rotation, used for orientation of layers (see <sil_rotate90()>)
+and of the display itself (only lnxFBdisplay.c, see sil_setRotationDisplay)
+
+SILROT_NONE - No rotation
+SILROT_90   - Rotated 90 degrees
+SILROT_180  - Rotated 180 degrees (upside down)
+SILROT_270  - Rotated 270 degrees
+*/
+#define SILROT_NONE  0
+#define SILROT_90    1
+#define SILROT_180   2
+#define SILROT_270   3
 
 
 /* bitmasks for keymodifiers/special keys */
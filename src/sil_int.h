@@ -2,12 +2,44 @@
 #define SILINT_H
 #include "sil.h"
 
+/* framebuffer.c */
+
+#define SILMASK_ALPHA 1
+#define SILMASK_KEY   2
+
+void sil_setMaskFB(SILFB *,BYTE,BYTE,BYTE,BYTE,BYTE);
+void sil_clearMaskFB(SILFB *);
+BYTE sil_hitMaskFB(SILFB *,UINT,UINT);
+void sil_quantizeFB(BYTE,BYTE *,BYTE *,BYTE *);
+BYTE sil_bytesFB(BYTE);
+void sil_unwrapFB(SILFB *);
+void sil_setTileLoaderFB(SILFB *,UINT (*)(struct _SILLYR *,SILFB *,UINT,UINT),struct _SILLYR *);
+void sil_damageFB(SILFB *,UINT,UINT,UINT,UINT);
+UINT sil_setCellFB(SILFB *,UINT,UINT,UINT);
+UINT sil_getCellFB(SILFB *,UINT,UINT);
+UINT sil_cellAtFB(SILFB *,UINT,UINT,UINT *,UINT *);
+void sil_fillCellsFB(SILFB *,UINT);
+void sil_repeatMapFB(SILFB *,UINT,UINT);
+UINT sil_addSpriteFB(SILFB *,int,int,UINT);
+UINT sil_setSpriteFB(SILFB *,UINT,int,int,UINT,BYTE,BYTE);
+UINT sil_getSpriteFB(SILFB *,UINT,int *,int *,UINT *,BYTE *,BYTE *);
+void sil_removeSpriteFB(SILFB *,UINT);
+UINT sil_spriteAtFB(SILFB *,UINT,UINT);
+void sil_sizeSliceFB(SILFB *,UINT,UINT);
+void sil_syncSliceFB(SILFB *);
+void sil_fillRowFB(SILFB *,UINT,UINT,UINT,BYTE,BYTE,BYTE,BYTE);
+
 /* layer.c */
 
 
 SILLYR *sil_findHighestClick(UINT,UINT);
 SILLYR *sil_findHighestHover(UINT,UINT);
 SILLYR *sil_findHighestKeyPress(UINT,BYTE);
+void sil_updateIndex(SILLYR *);
+BYTE sil_resolveLayer(SILLYR *,int *,int *,float *);
 void sil_LayersToFB(SILFB *);
+void sil_LayersToFBWindow(SILFB *, int, int);
+void sil_fillRowLayer(SILLYR *,UINT,UINT,UINT,BYTE,BYTE,BYTE,BYTE);
+void sil_blendRowLayer(SILLYR *,UINT,UINT,UINT,BYTE,BYTE,BYTE,BYTE);
 
 #endif